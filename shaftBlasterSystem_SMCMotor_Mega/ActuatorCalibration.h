@@ -0,0 +1,124 @@
+#ifndef ACTUATOR_CALIBRATION_H
+#define ACTUATOR_CALIBRATION_H
+
+#include "EepromStore.h"
+
+// Measured SMC move times, filled in by the TESTING (cycle test) state.
+// Moves are keyed by distance in 1/16th inch and direction, so the
+// 0->N / N->0 moves of the cycle test cover every distance the actuator
+// can travel. Stored in EEPROM so the firmware starts with real move times
+// instead of the fixed SMC_DEFAULT_MOVE_TIMEOUT_MS guess. Saving is done in the
+// background by serviceEepromStore(), the cycle test does not wait for it.
+
+#define CAL_VERSION 1 // bump when ActuatorCalibrationTable changes, older tables are then discarded
+#define CAL_DISTANCES 32 // index = distance in 1/16th inches, 0 is unused
+#define SMC_POSITION_UNKNOWN 0xFF
+
+#define SMC_DEFAULT_MOVE_TIMEOUT_MS 4000 // just a guess, used until a cycle test has calibrated the move
+#define CAL_TIMEOUT_MARGIN_MS 250        // calibrated timeout = max * 1.5 + margin
+
+typedef enum { CAL_EXTEND = 0, CAL_RETRACT = 1 } CAL_DIRECTION;
+
+struct MoveTimeStats {
+	uint16_t min_ms;
+	uint16_t mean_ms;
+	uint16_t max_ms;
+};
+
+struct ActuatorCalibrationTable {
+	StoredHeader header;
+	uint16_t cycles; // cycle test repetitions behind these numbers
+	MoveTimeStats moves[CAL_DISTANCES][2]; // [distance][CAL_DIRECTION]
+};
+
+// RAM only, collects one cycle test
+struct MoveTimeAccumulator {
+	unsigned long sum_ms;
+	uint16_t min_ms;
+	uint16_t max_ms;
+	uint16_t count;
+};
+
+ActuatorCalibrationTable actuator_calibration;
+MoveTimeAccumulator cal_accumulators[CAL_DISTANCES][2];
+bool actuator_calibration_valid = false;
+
+static_assert(CAL_EEPROM_START_ADDRESS + sizeof(ActuatorCalibrationTable) <= SEQUENCE_EEPROM_START_ADDRESS, "ActuatorCalibrationTable outgrew its EEPROM space");
+
+bool actuatorCalibrated() {
+	return actuator_calibration_valid;
+}
+
+void loadActuatorCalibration() {
+	actuator_calibration_valid = loadStored(CAL_EEPROM_START_ADDRESS, actuator_calibration, CAL_VERSION);
+	if (!actuator_calibration_valid) {
+		memset(&actuator_calibration, 0, sizeof(actuator_calibration));
+	}
+}
+
+void clearCalibrationAccumulators() {
+	for (uint8_t d = 0; d < CAL_DISTANCES; ++d) {
+		for (uint8_t dir = 0; dir < 2; ++dir) {
+			cal_accumulators[d][dir].sum_ms = 0;
+			cal_accumulators[d][dir].min_ms = 0xFFFF;
+			cal_accumulators[d][dir].max_ms = 0;
+			cal_accumulators[d][dir].count = 0;
+		}
+	}
+}
+
+void recordCalibrationMove(int from, int to, unsigned long move_ms) {
+	if (from == SMC_POSITION_UNKNOWN || from == to) {
+		return;
+	}
+	uint8_t distance = (to > from) ? (to - from) : (from - to);
+	MoveTimeAccumulator& acc = cal_accumulators[distance][(to > from) ? CAL_EXTEND : CAL_RETRACT];
+	if (move_ms > 0xFFFF) move_ms = 0xFFFF;
+	acc.sum_ms += move_ms;
+	if (move_ms < acc.min_ms) acc.min_ms = move_ms;
+	if (move_ms > acc.max_ms) acc.max_ms = move_ms;
+	acc.count++;
+}
+
+// turns the accumulators into the calibration table and queues it for EEPROM.
+// distances the test did not reach keep their previous numbers
+void saveActuatorCalibration(uint16_t cycles) {
+	for (uint8_t d = 1; d < CAL_DISTANCES; ++d) {
+		for (uint8_t dir = 0; dir < 2; ++dir) {
+			MoveTimeAccumulator& acc = cal_accumulators[d][dir];
+			if (acc.count == 0) continue;
+			actuator_calibration.moves[d][dir].min_ms = acc.min_ms;
+			actuator_calibration.moves[d][dir].mean_ms = acc.sum_ms / acc.count;
+			actuator_calibration.moves[d][dir].max_ms = acc.max_ms;
+		}
+	}
+	actuator_calibration.cycles = cycles;
+	actuator_calibration_valid = true;
+	saveStored(CAL_EEPROM_START_ADDRESS, actuator_calibration, CAL_VERSION);
+}
+
+// the calibrated stats for a move, NULL if this move has not been calibrated
+const MoveTimeStats* calibratedMove(int from, int to) {
+	if (!actuatorCalibrated() || from == SMC_POSITION_UNKNOWN || from == to) {
+		return NULL;
+	}
+	uint8_t distance = (to > from) ? (to - from) : (from - to);
+	const MoveTimeStats* stats = &actuator_calibration.moves[distance][(to > from) ? CAL_EXTEND : CAL_RETRACT];
+	return (stats->max_ms == 0) ? NULL : stats;
+}
+
+// mean move time, 0 if unknown. used to schedule around actuator latency
+unsigned long expectedMoveTimeMs(int from, int to) {
+	const MoveTimeStats* stats = calibratedMove(from, to);
+	return stats ? stats->mean_ms : 0;
+}
+
+unsigned long moveTimeoutMs(int from, int to) {
+	const MoveTimeStats* stats = calibratedMove(from, to);
+	if (!stats) {
+		return SMC_DEFAULT_MOVE_TIMEOUT_MS;
+	}
+	return ((unsigned long)stats->max_ms * 3) / 2 + CAL_TIMEOUT_MARGIN_MS;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef BLAST_SEQUENCE_H
+#define BLAST_SEQUENCE_H
+
+#include "MotorControl.h"
+#include "EepromStore.h"
+
+// Multi-position blast sequences.
+// Every shaft type has a list of (position, blast time) steps. When a shaft is
+// sensed in IDLE and the current shaft type has steps, the steps are copied
+// into the motion queue and the state machine runs
+// EXTENDING->BLASTING->EXTENDING->BLASTING... until the queue is empty,
+// without going back to IDLE in between. A retract step to position 0 is
+// queued after the last blast, so a sequence never leaves the actuator out.
+// A shaft type with no steps keeps the old single blast in place, and so does
+// a machine that is not homed.
+// The sequences are kept in EEPROM, every edit saves them.
+//
+// NOTE: nothing sets _homed_successfully yet. There is no SMC home command in
+// this firmware and the Nextion HOME button (trigger2) is commented out, so
+// sequences can be edited and saved but do not run until homing is wired up.
+
+#define MAX_SEQUENCE_STEPS 8
+
+struct BlastStep {
+	uint8_t position;  // 1/16th inch increments, 0..SMC_POSITION_COUNT-1
+	uint16_t blast_ms; // 0 = move only, the final retract
+};
+
+struct BlastSequence {
+	uint8_t count;
+	BlastStep steps[MAX_SEQUENCE_STEPS];
+};
+
+#define SEQUENCE_VERSION 1 // bump when BlastSequenceTable changes, older tables are then discarded
+
+struct BlastSequenceTable {
+	StoredHeader header;
+	BlastSequence sequences[2];
+};
+
+// indexed by shaftTypes. both blast in place until their tip zones are set up (Nextion trigger7)
+BlastSequenceTable blast_sequence_table;
+BlastSequence (&blast_sequences)[2] = blast_sequence_table.sequences;
+
+static_assert(SEQUENCE_EEPROM_START_ADDRESS + sizeof(BlastSequenceTable) <= NOZZLE_EEPROM_START_ADDRESS, "BlastSequenceTable outgrew its EEPROM space");
+
+void loadBlastSequences() {
+	if (!loadStored(SEQUENCE_EEPROM_START_ADDRESS, blast_sequence_table, SEQUENCE_VERSION)) {
+		memset(&blast_sequence_table, 0, sizeof(blast_sequence_table)); // no steps, blast in place
+	}
+}
+
+void saveBlastSequences() {
+	saveStored(SEQUENCE_EEPROM_START_ADDRESS, blast_sequence_table, SEQUENCE_VERSION);
+}
+
+// the steps of the sequence that is running right now, plus the retract
+#define MOTION_QUEUE_SIZE (MAX_SEQUENCE_STEPS + 1)
+BlastStep motion_queue[MOTION_QUEUE_SIZE];
+uint8_t motion_queue_head = 0;
+uint8_t motion_queue_count = 0;
+
+// the step EXTENDING/BLASTING are working on
+const BlastStep& currentBlastStep() {
+	return motion_queue[motion_queue_head];
+}
+
+// the move back to 0 after the last blast of a sequence
+bool currentStepIsRetract() {
+	return motion_queue_count > 0 && currentBlastStep().blast_ms == 0;
+}
+
+void popBlastStep() {
+	if (motion_queue_count == 0) return;
+	motion_queue_head = (motion_queue_head + 1) % MOTION_QUEUE_SIZE;
+	--motion_queue_count;
+}
+
+void clearMotionQueue() {
+	motion_queue_head = 0;
+	motion_queue_count = 0;
+}
+
+// returns false if the shaft type has no sequence
+bool queueBlastSequence(uint8_t shaft_type) {
+	clearMotionQueue();
+	const BlastSequence& sequence = blast_sequences[shaft_type];
+	if (sequence.count == 0) {
+		return false;
+	}
+	for (uint8_t i = 0; i < sequence.count; ++i) {
+		motion_queue[i] = sequence.steps[i];
+	}
+	motion_queue[sequence.count].position = 0;
+	motion_queue[sequence.count].blast_ms = 0;
+	motion_queue_count = sequence.count + 1;
+	return true;
+}
+
+// returns false if the sequence is full or the step is out of range
+bool addBlastSequenceStep(uint8_t shaft_type, int position, unsigned long blast_ms) {
+	BlastSequence& sequence = blast_sequences[shaft_type];
+	if (sequence.count >= MAX_SEQUENCE_STEPS || position < 0 || position >= SMC_POSITION_COUNT || blast_ms == 0 || blast_ms > 0xFFFF) {
+		return false;
+	}
+	sequence.steps[sequence.count].position = position;
+	sequence.steps[sequence.count].blast_ms = blast_ms;
+	sequence.count++;
+	saveBlastSequences();
+	return true;
+}
+
+void clearBlastSequence(uint8_t shaft_type) {
+	blast_sequences[shaft_type].count = 0;
+	saveBlastSequences();
+}
+
+#endif
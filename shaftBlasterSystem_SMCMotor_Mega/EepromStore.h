@@ -0,0 +1,112 @@
+#ifndef EEPROM_STORE_H
+#define EEPROM_STORE_H
+
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+// Records that live in EEPROM. Every record starts with a StoredHeader
+// (CRC + layout version), so a record written by firmware with a different
+// struct layout, or one torn by a reset, is rejected at load instead of being
+// used as garbage.
+//
+// An EEPROM byte write takes ~3.3 ms, so saveStored() does not write anything
+// itself: it queues the record and serviceEepromStore() (called from loop())
+// writes it a byte at a time, only when the previous byte has finished.
+// The header goes out last, so the CRC only matches once the whole record is in.
+// A record must not change while it is queued unless it is saved again, which
+// starts its write over.
+//
+// EEPROM layout:
+// 0x000 - 0x18F  actuator calibration (ActuatorCalibration.h)
+// 0x200 - 0x25F  blast sequences (BlastSequence.h)
+// 0x260 - 0x29F  nozzle profiles (NozzleSequencer.h)
+
+#define CAL_EEPROM_START_ADDRESS      0x000
+#define SEQUENCE_EEPROM_START_ADDRESS 0x200
+#define NOZZLE_EEPROM_START_ADDRESS   0x260
+#define EEPROM_STORE_END              0x2A0
+
+#define EEPROM_STORE_JOBS 3 // one per record above
+
+struct StoredHeader {
+	uint16_t crc;    // over every byte of the record after it
+	uint8_t version; // layout version of the record, 0 = never saved
+};
+
+struct EepromStoreJob {
+	uint16_t address;
+	const uint8_t* data;
+	uint16_t length;
+	uint16_t written; // bytes handled so far, the body first, then the header
+};
+
+EepromStoreJob eeprom_store_jobs[EEPROM_STORE_JOBS];
+uint8_t eeprom_store_job_count = 0;
+
+uint16_t storedCrc(const void* record, uint16_t length) {
+	const uint8_t* bytes = (const uint8_t*)record;
+	uint16_t crc = 0xFFFF;
+	for (uint16_t i = sizeof(uint16_t); i < length; ++i) {
+		crc = _crc16_update(crc, bytes[i]);
+	}
+	return crc;
+}
+
+void queueEepromWrite(uint16_t address, const void* data, uint16_t length) {
+	for (uint8_t i = 0; i < eeprom_store_job_count; ++i) {
+		if (eeprom_store_jobs[i].address == address) {
+			eeprom_store_jobs[i].written = 0; // saved again, start over
+			return;
+		}
+	}
+	if (eeprom_store_job_count == EEPROM_STORE_JOBS) {
+		return; // cannot happen with one job per record
+	}
+	EepromStoreJob& job = eeprom_store_jobs[eeprom_store_job_count++];
+	job.address = address;
+	job.data = (const uint8_t*)data;
+	job.length = length;
+	job.written = 0;
+}
+
+// returns false if the record is not valid for this layout version
+template <typename T>
+bool loadStored(uint16_t address, T& record, uint8_t version) {
+	EEPROM.get(address, record);
+	return record.header.version == version && record.header.crc == storedCrc(&record, sizeof(T));
+}
+
+template <typename T>
+void saveStored(uint16_t address, T& record, uint8_t version) {
+	record.header.version = version;
+	record.header.crc = storedCrc(&record, sizeof(T));
+	queueEepromWrite(address, &record, sizeof(T));
+}
+
+// never waits: returns as soon as a byte has to be written or the EEPROM is busy
+void serviceEepromStore() {
+	while (eeprom_store_job_count > 0 && eeprom_is_ready()) {
+		EepromStoreJob& job = eeprom_store_jobs[0];
+		if (job.written == job.length) {
+			for (uint8_t i = 1; i < eeprom_store_job_count; ++i) {
+				eeprom_store_jobs[i - 1] = eeprom_store_jobs[i];
+			}
+			--eeprom_store_job_count;
+			continue;
+		}
+		uint16_t offset = (job.written + sizeof(StoredHeader)) % job.length; // body first, header last
+		++job.written;
+		uint8_t value = job.data[offset];
+		if (EEPROM.read(job.address + offset) != value) {
+			EEPROM.write(job.address + offset, value); // starts the write, done ~3.3 ms later
+			return;
+		}
+	}
+}
+
+bool eepromStoreIdle() {
+	return eeprom_store_job_count == 0;
+}
+
+#endif
@@ -13,10 +13,10 @@ Digital 0-13+GND+AREF+SDA1+SCL1
 // **********************
 // Relay pin definitions
 // ===OUTPUTS===
-#define RELAY_1_CTRL 7 // sand blast (air solenoid valve) control pin
-#define RELAY_2_CTRL 6 // unused
-#define RELAY_3_CTRL 5 // unused
-#define RELAY_4_CTRL 4 // unused
+#define RELAY_1_CTRL 7 // sand blast (air solenoid valve) control pin - main nozzle
+#define RELAY_2_CTRL 6 // extra blast nozzle 2 (NozzleSequencer.h)
+#define RELAY_3_CTRL 5 // extra blast nozzle 3 (NozzleSequencer.h)
+#define RELAY_4_CTRL 4 // extra blast nozzle 4 (NozzleSequencer.h)
 
 // **********************
 // 4n27 Shaft-Presence Sense Pin
@@ -30,6 +30,11 @@ Digital 0-13+GND+AREF+SDA1+SCL1
 // ===OUTPUTS===
 #define LED_STATUS_INDICATOR_PIN 38 // D38 has a timer - not sure if this is needed for WS2812 comm
 
+// **********************
+// Nextion Display
+// D16 (TX2) / D17 (RX2)
+#define NEXTION_SERIAL Serial2
+
 // **********************
 // SMC Motor Control
 // ===OUTPUTS===
@@ -47,9 +52,22 @@ Digital 0-13+GND+AREF+SDA1+SCL1
 // ===INPUTS===
 #define SMC_BIT_BUSY  39
 
+// port/bit locations of the SMC pins for direct port access (MotorControl.h)
+// the position bits are split over two ports:
+// SMC_BIT_5 = D53 = PB0, SMC_BIT_4 = D51 = PB2
+// SMC_BIT_3 = D49 = PL0, SMC_BIT_2 = D47 = PL2, SMC_BIT_1 = D45 = PL4, SMC_BIT_0 = D43 = PL6
+// SMC_BIT_DRIVE = D41 = PG0, SMC_BIT_BUSY = D39 = PG2 (no pin-change interrupt on PG2)
+#define SMC_POS_PORTB_MASK (_BV(PB0) | _BV(PB2))
+#define SMC_POS_PORTL_MASK (_BV(PL0) | _BV(PL2) | _BV(PL4) | _BV(PL6))
+#define SMC_DRIVE_PORT_BIT _BV(PG0)
+#define SMC_BUSY_PIN_BIT   _BV(PG2)
+
 void initializePins() {
 	//OUTPUTS:
 	pinMode(RELAY_1_CTRL, OUTPUT);
+	pinMode(RELAY_2_CTRL, OUTPUT);
+	pinMode(RELAY_3_CTRL, OUTPUT);
+	pinMode(RELAY_4_CTRL, OUTPUT);
 	pinMode(LED_STATUS_INDICATOR_PIN, OUTPUT);
 	pinMode(SMC_BIT_5, OUTPUT);
 	pinMode(SMC_BIT_4, OUTPUT);
@@ -65,6 +83,9 @@ void initializePins() {
 	delaySafeMicro(100);
 	// SET INITIAL OUTPUT STATES
 	digitalWrite(RELAY_1_CTRL, LOW);
+	digitalWrite(RELAY_2_CTRL, LOW);
+	digitalWrite(RELAY_3_CTRL, LOW);
+	digitalWrite(RELAY_4_CTRL, LOW);
 	digitalWrite(LED_STATUS_INDICATOR_PIN, LOW);
 	digitalWrite(SMC_BIT_5, HIGH);
 	digitalWrite(SMC_BIT_4, HIGH);
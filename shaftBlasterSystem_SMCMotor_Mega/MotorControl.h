@@ -1,60 +1,211 @@
 #ifndef MOTOR_CONTROL_H
 #define MOTOR_CONTROL_H
 
+#include <util/atomic.h>
 #include "Mega2560PinDefs.h"
 #include "DelaySafe.h"
 #include "RGBLEDCONTROL.h"
+#include "ActuatorCalibration.h"
 
-// the SMC motor is controlled by a 6 bit position code 
+// the SMC motor is controlled by a 6 bit position code
 // (can correspond to 64 different pre-programmed positions)
 // We will only use 32 total positions (32 total 1/16th inch increments - total of 2 inches)
 // - the requested position ("location_point") will be derived from the user input on the Nextion display
 //
-// RETURNS TRUE IF MOTOR MOVEMENT WAS SUCCESSFUL
-// RETURNS FALSE IF MOTOR TIMED OUT DURING MOVEMENT
-bool setBinaryOutputToMotor(int location_point) {
-	if (location_point >= 32 || location_point < 0) {
-		// TODO: Set the status indicator for motor movement RED because
-		//       we are outside of our allowable range of positions
-		return;
+// Moves are asynchronous so blasterStateMachine.run() never blocks on the actuator:
+// 1. startActuatorMove() writes the position code and starts the DRIVE pulse
+// 2. Timer3 ends the DRIVE pulse after SMC_DRIVE_PULSE_MS, then samples BUSY every
+//    SMC_BUSY_SAMPLE_MS until it sees the rising edge (on arduino side) that ends the move
+// 3. the caller polls pollActuatorMove() with the handle it got back
+// The move timeout comes from the cycle test calibration (ActuatorCalibration.h) when there is one
+// BUSY (D39/PG2) has no pin-change interrupt on the Mega, so the timer samples it instead
+
+#define SMC_POSITION_COUNT 32
+#define SMC_DRIVE_PULSE_MS 15
+#define SMC_BUSY_SAMPLE_MS 1
+
+// Timer3 in CTC mode with a /64 prescaler = 4us per tick
+#define SMC_TIMER_TICKS_PER_MS 250
+
+typedef enum { MOVE_IDLE = 0, MOVE_DRIVING = 1, MOVE_WAIT_BUSY = 2, MOVE_DONE = 3, MOVE_TIMED_OUT = 4, MOVE_REJECTED = 5 } MOVE_STATUS;
+
+// identifies one requested move. 0 is never handed out
+typedef uint8_t MoveHandle;
+#define MOVE_HANDLE_NONE 0
+
+volatile MOVE_STATUS _smc_move_status = MOVE_IDLE;
+volatile bool _smc_busy_previous = true;
+volatile unsigned long _smc_move_end_us = 0;
+unsigned long _smc_move_start_us = 0;
+unsigned long _smc_move_start_ms = 0;
+unsigned long _smc_move_timeout_ms = SMC_DEFAULT_MOVE_TIMEOUT_MS;
+MoveHandle _smc_move_handle = MOVE_HANDLE_NONE;
+uint8_t _smc_position = SMC_POSITION_UNKNOWN; // where the actuator is after the last finished move
+uint8_t _smc_move_from = SMC_POSITION_UNKNOWN;
+uint8_t _smc_move_target = SMC_POSITION_UNKNOWN;
+
+// !!!!!! SMC LOGIC IS NEGATED - ARDUINO LOW = PLC TRUE !!!!!!
+#define SMC_DRIVE_ACTIVE   (PORTG &= ~SMC_DRIVE_PORT_BIT)
+#define SMC_DRIVE_INACTIVE (PORTG |= SMC_DRIVE_PORT_BIT)
+#define SMC_BUSY_HIGH      (PING & SMC_BUSY_PIN_BIT)
+
+void stopSMCTimer() {
+	TIMSK3 &= ~_BV(OCIE3A);
+	TCCR3B = 0;
+}
+
+void startSMCTimer(uint16_t period_ms) {
+	TCCR3B = 0;
+	TCCR3A = 0;
+	TCNT3 = 0;
+	OCR3A = (period_ms * SMC_TIMER_TICKS_PER_MS) - 1;
+	TIFR3 = _BV(OCF3A);
+	TIMSK3 |= _BV(OCIE3A);
+	TCCR3B = _BV(WGM32) | _BV(CS31) | _BV(CS30); // CTC, clk/64
+}
+
+ISR(TIMER3_COMPA_vect) {
+	bool busy_current = SMC_BUSY_HIGH;
+	if (_smc_move_status == MOVE_DRIVING) {
+		// end of the DRIVE pulse, start watching BUSY
+		SMC_DRIVE_INACTIVE;
+		OCR3A = (SMC_BUSY_SAMPLE_MS * SMC_TIMER_TICKS_PER_MS) - 1;
+		_smc_move_status = MOVE_WAIT_BUSY;
+	}
+	else if (_smc_move_status == MOVE_WAIT_BUSY) {
+		if (busy_current && !_smc_busy_previous) { // rising edge on arduino = falling edge on PLC
+			_smc_move_end_us = micros();
+			_smc_move_status = MOVE_DONE;
+			stopSMCTimer();
+		}
+	}
+	else {
+		stopSMCTimer();
+	}
+	_smc_busy_previous = busy_current;
+}
+
+// commits all six position bits with interrupts blocked. the bits live on two
+// ports (see Mega2560PinDefs.h), so this is two port writes a few cycles apart.
+// DRIVE is inactive while they change so the PLC never latches a partial code
+void writeSMCPositionBits(uint8_t location_point) {
+	uint8_t code = ~location_point; // negated logic
+	uint8_t portb_bits = 0;
+	uint8_t portl_bits = 0;
+	if (code & 0B100000) portb_bits |= _BV(PB0); // SMC_BIT_5
+	if (code & 0B010000) portb_bits |= _BV(PB2); // SMC_BIT_4
+	if (code & 0B001000) portl_bits |= _BV(PL0); // SMC_BIT_3
+	if (code & 0B000100) portl_bits |= _BV(PL2); // SMC_BIT_2
+	if (code & 0B000010) portl_bits |= _BV(PL4); // SMC_BIT_1
+	if (code & 0B000001) portl_bits |= _BV(PL6); // SMC_BIT_0
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		PORTB = (PORTB & ~SMC_POS_PORTB_MASK) | portb_bits;
+		PORTL = (PORTL & ~SMC_POS_PORTL_MASK) | portl_bits;
+	}
+}
+
+bool actuatorMoveInProgress() {
+	return _smc_move_status == MOVE_DRIVING || _smc_move_status == MOVE_WAIT_BUSY;
+}
+
+// RETURNS A HANDLE TO POLL WITH pollActuatorMove()
+// RETURNS MOVE_HANDLE_NONE IF THE POSITION IS OUT OF RANGE OR A MOVE IS ALREADY RUNNING
+MoveHandle startActuatorMove(int location_point) {
+	if (location_point >= SMC_POSITION_COUNT || location_point < 0 || actuatorMoveInProgress()) {
+		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
+		return MOVE_HANDLE_NONE;
 	}
 
 	rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_PROCESSING);
 
-	digitalWrite(SMC_BIT_DRIVE, HIGH); // make sure drive is FALSE (on PLC side) while we set our position bits
-	digitalWrite(SMC_BIT_5, !(0B100000 & location_point));
-	digitalWrite(SMC_BIT_4, !(0B010000 & location_point));
-	digitalWrite(SMC_BIT_3, !(0B001000 & location_point));
-	digitalWrite(SMC_BIT_2, !(0B000100 & location_point));
-	digitalWrite(SMC_BIT_1, !(0B000010 & location_point));
-	digitalWrite(SMC_BIT_0, !(0B000001 & location_point));
-
-	bool busy_status_prev, busy_status_curr = true;
-	// Now that the bits are set, pulse DRIVE signal high (on PLC side) ~15msec
-	digitalWrite(SMC_BIT_DRIVE, LOW);
-	delaySafeMilli(15);
-	digitalWrite(SMC_BIT_DRIVE, HIGH);
-	// when actuator is finished moving the BUSY bit should experience a rising transition (on arduino side)
-	unsigned long motor_start_time = millis();
-	unsigned long motor_move_timeout = 4000; // just a guess for now
-	bool finished = false;
-	while (!finished && (millis() - motor_start_time <= motor_move_timeout)) {
-		busy_status_curr = digitalRead(SMC_BIT_BUSY);
-		if ((busy_status_curr != busy_status_prev) && busy_status_curr == true) { // rising edge on arduino = falling edge on PLC
-			finished = true;
-			rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_NO_ERROR);
-			break;
-		}
-		busy_status_prev = busy_status_curr;
+	SMC_DRIVE_INACTIVE; // make sure drive is FALSE (on PLC side) while we set our position bits
+	writeSMCPositionBits(location_point);
+
+	if (++_smc_move_handle == MOVE_HANDLE_NONE) ++_smc_move_handle;
+	_smc_move_from = _smc_position;
+	_smc_move_target = location_point;
+	_smc_move_timeout_ms = moveTimeoutMs(_smc_move_from, _smc_move_target);
+	_smc_position = SMC_POSITION_UNKNOWN; // until the move finishes
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		_smc_move_status = MOVE_DRIVING;
+		_smc_busy_previous = SMC_BUSY_HIGH;
+		_smc_move_start_us = micros();
+		_smc_move_start_ms = millis();
+		// Now that the bits are set, pulse DRIVE signal high (on PLC side), Timer3 ends the pulse
+		SMC_DRIVE_ACTIVE;
+		startSMCTimer(SMC_DRIVE_PULSE_MS);
+	}
+
+	return _smc_move_handle;
+}
+
+// called from the state machine every run(), never blocks
+MOVE_STATUS pollActuatorMove(MoveHandle handle) {
+	if (handle == MOVE_HANDLE_NONE) {
+		return MOVE_REJECTED;
+	}
+	if (handle != _smc_move_handle) {
+		return MOVE_IDLE; // stale handle, a newer move has been started since
 	}
 
-	if (!finished) {
+	if (actuatorMoveInProgress() && (millis() - _smc_move_start_ms > _smc_move_timeout_ms)) {
 		// error condition - we timed out on motor movement, something is wrong
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			stopSMCTimer();
+			SMC_DRIVE_INACTIVE;
+			_smc_move_status = MOVE_TIMED_OUT;
+		}
 		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
 	}
+	else if (_smc_move_status == MOVE_DONE) {
+		_smc_position = _smc_move_target;
+	}
 
-	return finished;
+	return _smc_move_status;
 }
 
-#endif
+uint8_t actuatorPosition() {
+	return _smc_position;
+}
 
+// where the actuator should be right now. the SMC reports nothing between DRIVE and
+// BUSY, so during a move the position is interpolated along the calibrated mean move
+// time (ActuatorCalibration.h). without calibration the actuator is taken to still be
+// at its start position until BUSY ends the move, so callers only ever see it late.
+// SMC_POSITION_UNKNOWN if the start position is not known
+uint8_t actuatorEstimatedPosition() {
+	if (!actuatorMoveInProgress()) {
+		return (_smc_move_status == MOVE_DONE) ? _smc_move_target : _smc_position;
+	}
+	unsigned long expected_ms = expectedMoveTimeMs(_smc_move_from, _smc_move_target);
+	if (expected_ms == 0) {
+		return _smc_move_from;
+	}
+	unsigned long elapsed_ms = millis() - _smc_move_start_ms;
+	if (elapsed_ms > expected_ms) elapsed_ms = expected_ms;
+	uint8_t distance = (_smc_move_target > _smc_move_from) ? (_smc_move_target - _smc_move_from) : (_smc_move_from - _smc_move_target);
+	uint8_t travelled = (distance * elapsed_ms) / expected_ms;
+	return (_smc_move_target > _smc_move_from) ? (_smc_move_from + travelled) : (_smc_move_from - travelled);
+}
+
+uint8_t actuatorLastMoveFrom() {
+	return _smc_move_from;
+}
+
+// where the move in progress (or the last one) was commanded to, fixed for the whole move
+uint8_t actuatorMoveTarget() {
+	return _smc_move_target;
+}
+
+// microseconds from the start of the DRIVE pulse to the BUSY edge of the last finished move
+unsigned long actuatorLastMoveTimeMicros() {
+	unsigned long end_us;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		end_us = _smc_move_end_us;
+	}
+	return end_us - _smc_move_start_us;
+}
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <EasyNextionLibrary.h>
 #include "MotorControl.h"
+#include "BlastSequence.h"
+#include "ProgramStates.h"
+#include "NozzleSequencer.h"
 
 // externs from ShaftTipBlastSystem_Mega.ino
 extern EasyNex myNex;
@@ -16,11 +19,10 @@ extern bool nbTrigger5; // Start Cycle Test
 //extern bool nbTrigger6; // Start blasting **!! This won't be triggered through nextion !!**
 extern int requested_sixteenths_to_move;
 extern int test_cycles;
+extern bool overlap_enabled;
+extern int overlap_blast_position;
 
 
-// externs from MotorControl.h
-extern bool setBinaryOutputToMotor(int num_of_sixteenth_increments);
-
 // this trigger is only for testing and debugging. 
 // ultimately, the operator will not be allowed to 
 // move the actuator in the retract direction, the
@@ -63,13 +65,82 @@ void trigger4() {
     currentShaft = steel;
 }
 
-// might need to create a state for this test
-// ONLY S0->Cycling State and Cycling State->S0 allowed
+// ONLY S0->TESTING and TESTING->S0 allowed
+// the cycle test always visits all 32 positions, n1 sets how many times
 void trigger5() {
     // start cycle test
-    nbtrigger5 = true;
-    test_cycles = mynex.readnumber("n1.val");
-    requested_sixteenths_to_move = mynex.readnumber("n0.val");
+    nbTrigger5 = true;
+    test_cycles = myNex.readNumber("n1.val");
+}
+
+// blast sequence editing, for the shaft type that is selected right now
+// n0 = position in 1/16th inches, n2 = blast time in ms
+void trigger7() {
+    // ADD SEQUENCE STEP
+    if (addBlastSequenceStep(currentShaft, myNex.readNumber("n0.val"), myNex.readNumber("n2.val"))) {
+        myNex.writeStr("t2.txt", "STEP " + String(blast_sequences[currentShaft].count) + " ADDED");
+    }
+    else {
+        myNex.writeStr("t2.txt", "STEP REJECTED");
+    }
+}
+
+void trigger8() {
+    // CLEAR SEQUENCE - back to a single blast in place
+    clearBlastSequence(currentShaft);
+    myNex.writeStr("t2.txt", "SEQUENCE CLEARED");
+}
+
+// overlapped extend + blast (EXTEND_BLASTING in ProgramStates.h)
+// n3 = position the valve opens at in 1/16th inches, anything outside 0-31 turns overlap off
+void trigger9() {
+    int position = myNex.readNumber("n3.val");
+    if (position >= 0 && position < SMC_POSITION_COUNT) {
+        overlap_blast_position = position;
+        overlap_enabled = true;
+        myNex.writeStr("t2.txt", "OVERLAP AT " + String(position));
+    }
+    else {
+        overlap_enabled = false;
+        myNex.writeStr("t2.txt", "OVERLAP OFF");
+    }
+}
+
+// state timing (StaticStateMachine.h), each press shows the next of HOMING, EXTENDING, BLASTING
+void trigger10() {
+    static const char* const names[] = { "HOMING", "EXTENDING", "BLASTING" };
+    static uint8_t shown = 2;
+    shown = (shown + 1) % 3;
+    uint8_t state = HOMING + shown;
+    const StateTiming& timing = blasterStateMachine.stateTiming(state);
+    String text = String(names[shown]) + " LAST " + String(timing.last_ms) + "ms TOTAL " + String(timing.total_ms) + "ms RUNS " + String(timing.visits);
+    if (blasterStateMachine.currentState() == state) {
+        text += " NOW " + String(blasterStateMachine.timeInCurrentState()) + "ms";
+    }
+    myNex.writeStr("t2.txt", text);
+}
+
+// nozzle profile editing (NozzleSequencer.h), for the shaft type that is selected right now
+// n4 = nozzle 1-4, n5 = delay from the start of the blast in ms,
+// n6 = on time in ms, 0 = nozzle not used, 65535 = the whole blast time
+void trigger11() {
+    int nozzle = myNex.readNumber("n4.val");
+    if (setNozzleTiming(currentShaft, nozzle - 1, myNex.readNumber("n5.val"), myNex.readNumber("n6.val"))) {
+        myNex.writeStr("t2.txt", "NOZZLE " + String(nozzle) + " SET");
+    }
+    else {
+        myNex.writeStr("t2.txt", "NOZZLE REJECTED");
+    }
+}
+
+// n7 = how many nozzles may be open at the same time, 1-4
+void trigger12() {
+    if (setMaxOpenNozzles(myNex.readNumber("n7.val"))) {
+        myNex.writeStr("t2.txt", "MAX OPEN " + String(max_open_nozzles));
+    }
+    else {
+        myNex.writeStr("t2.txt", "MAX OPEN REJECTED");
+    }
 }
 
 #endif
@@ -0,0 +1,156 @@
+#ifndef NOZZLE_SEQUENCER_H
+#define NOZZLE_SEQUENCER_H
+
+#include "Mega2560PinDefs.h"
+#include "EepromStore.h"
+
+// Drives up to four blast valves (RELAY_1_CTRL..RELAY_4_CTRL) during one blast.
+// Every shaft type has a profile with a start delay and an on time per nozzle,
+// so nozzles can run together or staggered. At most max_open_nozzles valves are
+// open at the same time (shop air supply). A nozzle that is due while the limit
+// is reached waits for a free slot and still gets its full on time.
+// The BLASTING and EXTEND_BLASTING states start a sequence, call serviceNozzles()
+// from their run hooks and poll nozzleSequenceDone(). The pins are set up in
+// initializePins().
+// The profiles and the open limit are edited from the Nextion (trigger11/trigger12)
+// and kept in EEPROM, every edit saves them.
+
+#define NOZZLE_COUNT 4
+#define NOZZLE_FULL_BLAST 0xFFFF // on time = the blast time the state asked for
+#define NOZZLE_UNUSED 0          // on time of a nozzle that stays closed
+
+struct NozzleTiming {
+	uint16_t delay_ms; // from the start of the blast
+	uint16_t on_ms;    // NOZZLE_FULL_BLAST or NOZZLE_UNUSED allowed
+};
+
+struct NozzleProfile {
+	NozzleTiming nozzles[NOZZLE_COUNT];
+};
+
+typedef enum { NOZZLE_DONE = 0, NOZZLE_WAITING = 1, NOZZLE_OPEN = 2 } NOZZLE_STATE; // DONE = 0 so nothing is pending at power up
+
+const uint8_t nozzle_pins[NOZZLE_COUNT] = { RELAY_1_CTRL, RELAY_2_CTRL, RELAY_3_CTRL, RELAY_4_CTRL };
+
+#define NOZZLE_VERSION 1 // bump when NozzleConfig changes, older configs are then discarded
+#define NOZZLE_DEFAULT_MAX_OPEN 2
+
+struct NozzleConfig {
+	StoredHeader header;
+	NozzleProfile profiles[2]; // indexed by shaftTypes
+	uint8_t max_open_nozzles;  // 0 is treated as 1, a sequence must always be able to finish
+};
+
+NozzleConfig nozzle_config;
+NozzleProfile (&nozzle_profiles)[2] = nozzle_config.profiles;
+uint8_t& max_open_nozzles = nozzle_config.max_open_nozzles;
+
+static_assert(NOZZLE_EEPROM_START_ADDRESS + sizeof(NozzleConfig) <= EEPROM_STORE_END, "NozzleConfig outgrew its EEPROM space");
+
+NOZZLE_STATE nozzle_state[NOZZLE_COUNT];
+unsigned long nozzle_opened_ms[NOZZLE_COUNT];
+unsigned long nozzle_on_ms[NOZZLE_COUNT];
+unsigned long nozzle_sequence_start_ms = 0;
+uint8_t nozzle_profile_index = 0;
+uint8_t nozzles_open = 0;
+
+// every shaft type blasts with nozzle 1 only
+void defaultNozzleConfig() {
+	for (uint8_t shaft = 0; shaft < 2; ++shaft) {
+		for (uint8_t i = 0; i < NOZZLE_COUNT; ++i) {
+			nozzle_profiles[shaft].nozzles[i].delay_ms = 0;
+			nozzle_profiles[shaft].nozzles[i].on_ms = (i == 0) ? NOZZLE_FULL_BLAST : NOZZLE_UNUSED;
+		}
+	}
+	max_open_nozzles = NOZZLE_DEFAULT_MAX_OPEN;
+}
+
+void loadNozzleConfig() {
+	if (!loadStored(NOZZLE_EEPROM_START_ADDRESS, nozzle_config, NOZZLE_VERSION)) {
+		defaultNozzleConfig();
+	}
+}
+
+void saveNozzleConfig() {
+	saveStored(NOZZLE_EEPROM_START_ADDRESS, nozzle_config, NOZZLE_VERSION);
+}
+
+// nozzle is 0..NOZZLE_COUNT-1. a blast in progress picks up the new delay right away
+bool setNozzleTiming(uint8_t shaft_type, int nozzle, unsigned long delay_ms, unsigned long on_ms) {
+	if (nozzle < 0 || nozzle >= NOZZLE_COUNT || delay_ms > 0xFFFF || on_ms > 0xFFFF) {
+		return false;
+	}
+	nozzle_profiles[shaft_type].nozzles[nozzle].delay_ms = delay_ms;
+	nozzle_profiles[shaft_type].nozzles[nozzle].on_ms = on_ms;
+	saveNozzleConfig();
+	return true;
+}
+
+bool setMaxOpenNozzles(unsigned long limit) {
+	if (limit < 1 || limit > NOZZLE_COUNT) {
+		return false;
+	}
+	max_open_nozzles = limit;
+	saveNozzleConfig();
+	return true;
+}
+
+// closes every valve, used by the state exit hooks so no way out of a blast leaves one open
+void closeAllNozzles() {
+	for (uint8_t i = 0; i < NOZZLE_COUNT; ++i) {
+		digitalWrite(nozzle_pins[i], LOW);
+		nozzle_state[i] = NOZZLE_DONE;
+	}
+	nozzles_open = 0;
+}
+
+void openNozzle(uint8_t i, unsigned long now) {
+	digitalWrite(nozzle_pins[i], HIGH);
+	nozzle_state[i] = NOZZLE_OPEN;
+	nozzle_opened_ms[i] = now;
+	nozzles_open++;
+}
+
+void closeNozzle(uint8_t i) {
+	digitalWrite(nozzle_pins[i], LOW);
+	nozzle_state[i] = NOZZLE_DONE;
+	nozzles_open--;
+}
+
+// closes the nozzles whose time is up first, so their slots are free for the ones that are due
+void serviceNozzles() {
+	unsigned long now = millis();
+	for (uint8_t i = 0; i < NOZZLE_COUNT; ++i) {
+		if (nozzle_state[i] == NOZZLE_OPEN && now - nozzle_opened_ms[i] >= nozzle_on_ms[i]) {
+			closeNozzle(i);
+		}
+	}
+	uint8_t limit = max_open_nozzles ? max_open_nozzles : 1;
+	for (uint8_t i = 0; i < NOZZLE_COUNT && nozzles_open < limit; ++i) {
+		if (nozzle_state[i] == NOZZLE_WAITING && now - nozzle_sequence_start_ms >= nozzle_profiles[nozzle_profile_index].nozzles[i].delay_ms) {
+			openNozzle(i, now);
+		}
+	}
+}
+
+void startNozzleSequence(uint8_t shaft_type, unsigned long blast_ms) {
+	closeAllNozzles();
+	nozzle_profile_index = shaft_type;
+	nozzle_sequence_start_ms = millis();
+	for (uint8_t i = 0; i < NOZZLE_COUNT; ++i) {
+		const NozzleTiming& timing = nozzle_profiles[shaft_type].nozzles[i];
+		if (timing.on_ms == NOZZLE_UNUSED) continue;
+		nozzle_on_ms[i] = (timing.on_ms == NOZZLE_FULL_BLAST) ? blast_ms : timing.on_ms;
+		nozzle_state[i] = NOZZLE_WAITING;
+	}
+	serviceNozzles(); // nozzles without a delay open right away
+}
+
+bool nozzleSequenceDone() {
+	for (uint8_t i = 0; i < NOZZLE_COUNT; ++i) {
+		if (nozzle_state[i] != NOZZLE_DONE) return false;
+	}
+	return true;
+}
+
+#endif
@@ -5,12 +5,20 @@
 2 - EXTENDING
 3 - BLASTING
 4 - ERROR/UNKNOWN
+5 - TESTING (cycle test)
+6 - EXTEND_BLASTING (extension and blast overlapped)
+
+Nothing sets _homed_successfully yet (no SMC home command, the Nextion HOME
+button is commented out), so the transitions below that need "homed" cannot
+be taken until homing is wired up.
 
 Valid Transition Definitions:
 State 0 (IDLE):
 0->1 (HOMING)
 0->2 (EXTENDING)
+0->2 (EXTENDING) - shaft sensed, homed and the shaft type has a blast sequence (BlastSequence.h)
 0->3 (BLASTING)
+0->6 (EXTEND_BLASTING) - shaft sensed, homed and overlap is enabled
 0->4 (ERROR)
 
 State 1 (HOMING):
@@ -19,15 +27,22 @@ State 1 (HOMING):
 1->4 (ERROR)
 
 State 2 (EXTENDING):
-2->0 (IDLE)
+2->0 (IDLE) - also after the retract step of a blast sequence
+2->3 (BLASTING) - next step of a blast sequence
 2->4 (ERROR) - exceeded time/click counter not increasing
 
 State 3 (BLASTING):
 3->0 (IDLE)
-3->4 (ERROR) - cannot turn on/off pneumatics (how to check for this?)
+3->2 (EXTENDING) - blast sequence has more steps (the last one is the retract)
+3->4 (ERROR) - placeholder, always false: there is no pneumatics feedback to check
+         yet, so BLASTING has no error guard and cannot reach ERROR
 
 State 4 (ERROR):
 4->0 (IDLE) - error manually acknowledged (how?)
+
+State 6 (EXTEND_BLASTING):
+6->4 (ERROR) - same guards as 2->4 and 3->4 (only 2->4 can fire)
+6->0 (IDLE) - move finished and blast finished
 */
 
 #ifndef PROGRAM_STATES_H
@@ -35,6 +50,10 @@ State 4 (ERROR):
 
 #include "RGBLEDCONTROL.h"
 #include "Mega2560PinDefs.h"
+#include "MotorControl.h"
+#include "StaticStateMachine.h"
+#include "BlastSequence.h"
+#include "NozzleSequencer.h"
 
 // from ShaftTipBlastSystem_Mega.ino
 extern bool nbTrigger0; // Reverse Actuator 1 Second Button Hit
@@ -46,56 +65,50 @@ extern bool nbTrigger5; // Start Cycle Test
 extern bool nbTrigger6; // Start Blasting
 extern bool _homed_successfully;
 extern int requested_sixteenths_to_move;
+extern int test_cycles;
+extern shaftTypes currentShaft;
 extern EasyNex myNex;
 
-StateMachine blasterStateMachine = StateMachine();
-enum MACHINESTATE { IDLE = 0, HOMING = 1, EXTENDING = 2, BLASTING = 3, ERROR = 4, TESTING = 5 };
+enum MACHINESTATE { IDLE = 0, HOMING = 1, EXTENDING = 2, BLASTING = 3, ERROR = 4, TESTING = 5, EXTEND_BLASTING = 6, MACHINESTATE_COUNT = 7 };
+extern StaticStateMachine<MACHINESTATE_COUNT> blasterStateMachine; // defined below the state tables
 MACHINESTATE _machine_state = IDLE;
 
 unsigned long blast_time = 0;
 unsigned long blast_on_timer = 2000; // TODO: The "ON" blast times need to be defined
+unsigned long blast_duration_ms = 0; // blast_on_timer, or the blast time of the current sequence step
+bool sequence_running = false;       // EXTENDING/BLASTING are working through the motion queue
+bool overlap_enabled = false;        // shaft sense starts EXTEND_BLASTING instead of BLASTING
+int overlap_blast_position = 0;      // the valve opens once the actuator is past this position (1/16th inches)
+bool overlap_valve_opened = false;
 bool blasting_complete = false;
 bool extending_complete = false;
+MoveHandle extend_move = MOVE_HANDLE_NONE;
 bool testing_complete = false;
-
-// **************************************
-// ****** initialization section: *******
-// **************************************
-// prototypes
-void state0(void);
-void state1(void);
-void state2(void);
-void state3(void);
-void state4(void);
-void state5(void); // just for testing
-State* S0 = blasterStateMachine.addState(&state0);
-State* S1 = blasterStateMachine.addState(&state1);
-State* S2 = blasterStateMachine.addState(&state2);
-State* S3 = blasterStateMachine.addState(&state3);
-State* S4 = blasterStateMachine.addState(&state4);
-State* S5 = blasterStateMachine.addState(&state5); // just for testing
+int test_cycle = 0;    // cycle test repetitions finished so far
+int test_position = 0; // position the cycle test is visiting, it returns to 0 in between
+MoveHandle test_move = MOVE_HANDLE_NONE;
 
 // ==================================================================================
 // *****************************
 // **** STATE0 (IDLE STATE) ****
 // *****************************
-void state0() {
+void enterIdle() {
 	// IDLE
-	if (blasterStateMachine.executeOnce) {
-		_machine_state = IDLE;
-		// don't allow errant button presses from previous states
-		// to corrupt a fresh state 0 transition
-		nbTrigger0 = false; // Reverse Actuator 1 Second Button Hit
-		nbTrigger1 = false; // Jog Extend button hit
-		nbTrigger2 = false; // Home button hit
-		nbTrigger3 = false; // Graphite Shaft Selected
-		nbTrigger4 = false; // Steel Shaft Selected 
-		nbTrigger5 = false; // Start Cycle Test
-		nbTrigger6 = false; // Start Blasting
-		blasting_complete = false; // controls S3->S0 transition
-		extending_complete = false;
-		rgbSetLEDColor(LED_STATE::LED_IDLE, RGB_CLR_IND::RGB_NO_ERROR);
-	}
+	_machine_state = IDLE;
+	// don't allow errant button presses from previous states
+	// to corrupt a fresh state 0 transition
+	nbTrigger0 = false; // Reverse Actuator 1 Second Button Hit
+	nbTrigger1 = false; // Jog Extend button hit
+	nbTrigger2 = false; // Home button hit
+	nbTrigger3 = false; // Graphite Shaft Selected
+	nbTrigger4 = false; // Steel Shaft Selected 
+	nbTrigger5 = false; // Start Cycle Test
+	nbTrigger6 = false; // Start Blasting
+	blasting_complete = false; // controls S3->S0 transition
+	extending_complete = false;
+	sequence_running = false;
+	clearMotionQueue();
+	rgbSetLEDColor(LED_STATE::LED_IDLE, RGB_CLR_IND::RGB_NO_ERROR);
 }
 
 // TODO: FIGURE OUT HOW TO FORCE HOME THE SMC MOTOR
@@ -116,6 +129,16 @@ bool transitionS0S2() { // IDLE->EXTENDING
 	return false;
 }
 
+bool transitionS0S2Sequence() { // IDLE->EXTENDING, first step of a blast sequence
+	// an unhomed machine falls through to S0S3 and blasts in place
+	if (nbTrigger6 && _homed_successfully && queueBlastSequence(currentShaft)) { // shaft sensed and this shaft type has steps
+		nbTrigger6 = false;
+		sequence_running = true;
+		return true;
+	}
+	return false;
+}
+
 bool transitionS0S3() { // IDLE->BLASTING
 	if (nbTrigger6) { // shaft tip sensor (from main loop) senses a shaft is present
 		nbTrigger6 = false;
@@ -125,6 +148,16 @@ bool transitionS0S3() { // IDLE->BLASTING
 	return false;
 }
 
+bool transitionS0S6() { // IDLE->EXTEND_BLASTING
+	if (nbTrigger6 && overlap_enabled && _homed_successfully) { // shaft sensed, extend and blast at the same time
+		// not homed: falls through to S0S3 and blasts in place
+		nbTrigger6 = false;
+		blasting_complete = false;
+		return true;
+	}
+	return false;
+}
+
 bool transitionS0S4() { // IDLE->ERROR
 	if (false) {
 		// TODO:
@@ -147,19 +180,17 @@ bool transitionS0S5() { // IDLE->TESTING **TEMPORARY**
 // *******************************
 // **** STATE1 (HOMING STATE) ****
 // *******************************
-void state1() {
+void enterHoming() {
 	// HOMING
-	if (blasterStateMachine.executeOnce) {
-		_machine_state = HOMING;
-		rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_PROCESSING);
-		// TODO: Figure out how to force home SMC motor
-		if (!_homed_successfully) {
-			rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_ERROR);
-			blasterStateMachine.transitionTo(S4); // force transition to error state
-			return; // TODO: i think we need this?
-		}
-		rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_NO_ERROR);
+	_machine_state = HOMING;
+	rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_PROCESSING);
+	// TODO: Figure out how to force home SMC motor
+	if (!_homed_successfully) {
+		rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_ERROR);
+		blasterStateMachine.transitionTo(ERROR); // force transition to error state
+		return;
 	}
+	rgbSetLEDColor(LED_STATE::LED_HOMING, RGB_CLR_IND::RGB_NO_ERROR);
 }
 
 bool transitionS1S0() { // HOMING->IDLE
@@ -168,43 +199,57 @@ bool transitionS1S0() { // HOMING->IDLE
 	}
 	return false;
 }
-bool transitionS1S2() {} // HOMING->EXTENDING **!! THIS TRANSITION IS OBSOLETE. EXTENDING INCLUDES HOMING !!**
-bool transitionS1S4() {} // HOMING->ERROR **!! THIS TRANSITION IS OBSOLETE. ERROR TRANSITION IS FORCED IN state1()
+bool transitionS1S2() { return false; } // HOMING->EXTENDING **!! THIS TRANSITION IS OBSOLETE. EXTENDING INCLUDES HOMING !!**
+bool transitionS1S4() { return false; } // HOMING->ERROR **!! THIS TRANSITION IS OBSOLETE. ERROR TRANSITION IS FORCED IN enterHoming()
 
 // ==================================================================================
 // **********************************
 // **** STATE2 (EXTENDING STATE) ****
 // **********************************
-void state2() {
+void enterExtending() {
 	// EXTENDING
-	if (blasterStateMachine.executeOnce) {
-		_machine_state = EXTENDING;
-		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_PROCESSING);
-		// TODO: check if _homed_successfully is TRUE, if so skip homing
-		if (!_homed_successfully) {
-			rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
-			blasterStateMachine.transitionTo(S4); // force transition to error state
-			return; // TODO: i think we need this?
-		}
+	_machine_state = EXTENDING;
+	rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_PROCESSING);
+	extend_move = MOVE_HANDLE_NONE;
+	extending_complete = false;
+	// TODO: check if _homed_successfully is TRUE, if so skip homing
+	if (!_homed_successfully) {
+		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
+		blasterStateMachine.transitionTo(ERROR); // force transition to error state
+		return;
+	}
 
-		if (!setBinaryOutputToMotor(requested_sixteenths_to_move)) {
-			rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
-			blasterStateMachine.transitionTo(S4); // force transition to error state
-			return; // TODO: i think we need this?
-		}
+	// the move runs in the background, see MotorControl.h
+	extend_move = startActuatorMove(sequence_running ? currentBlastStep().position : requested_sixteenths_to_move);
+}
+
+void runExtending() {
+	if (!extending_complete && pollActuatorMove(extend_move) == MOVE_DONE) {
 		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_NO_ERROR);
 		extending_complete = true;
 	}
 }
 
-bool transitionS2S0() { // EXTENDING->IDLE
-	if (extending_complete && _homed_successfully) {
+bool transitionS2S3() { // EXTENDING->BLASTING, blast sequence step is in position
+	if (sequence_running && !currentStepIsRetract() && extending_complete && _homed_successfully) {
 		return true;
 	}
 	return false;
 }
 
-bool transitionS2S4() {
+bool transitionS2S0() { // EXTENDING->IDLE, jog move or the retract of a blast sequence done
+	if ((!sequence_running || currentStepIsRetract()) && extending_complete && _homed_successfully) {
+		return true;
+	}
+	return false;
+}
+
+bool transitionS2S4() { // EXTENDING->ERROR
+	MOVE_STATUS move_status = pollActuatorMove(extend_move);
+	if (move_status == MOVE_TIMED_OUT || move_status == MOVE_REJECTED) {
+		// startActuatorMove()/pollActuatorMove() already set the LED red
+		return true;
+	}
 	if (extending_complete && !_homed_successfully) {
 		rgbSetLEDColor(LED_STATE::LED_EXTENDING, RGB_CLR_IND::RGB_ERROR);
 		return true;
@@ -216,65 +261,122 @@ bool transitionS2S4() {
 // *********************************
 // **** STATE3 (BLASTING STATE) ****
 // *********************************
-void state3() {
+// BLASTING never blocks while the valves are open: entry starts the nozzle sequence
+// for the current shaft type (NozzleSequencer.h), the run hook opens/closes the
+// nozzles on their timings, the S3->S0 guard waits for all of them to finish and the
+// exit hook closes every valve on any way out and moves a blast sequence on to its next step
+void enterBlasting() {
 	// BLASTING
-	if (blasterStateMachine.executeOnce) {
-		rgbSetLEDColor(LED_STATE::LED_BLASTING, RGB_CLR_IND::RGB_PROCESSING);
-		_machine_state = BLASTING;
-		// POSSIBLE TODO: Check if Air Pressure is good before blasting
-		blast_time = millis();
-		digitalWrite(RELAY_1_CTRL, HIGH);
-		while (millis() - blast_time >= blast_on_timer) {
-			// just wait
-		}
-		blasting_complete = true;
+	rgbSetLEDColor(LED_STATE::LED_BLASTING, RGB_CLR_IND::RGB_PROCESSING);
+	_machine_state = BLASTING;
+	// POSSIBLE TODO: Check if Air Pressure is good before blasting
+	blast_time = millis();
+	blast_duration_ms = sequence_running ? currentBlastStep().blast_ms : blast_on_timer;
+	blasting_complete = false;
+	startNozzleSequence(currentShaft, blast_duration_ms);
+}
+
+void runBlasting() {
+	serviceNozzles();
+}
+
+void exitBlasting() {
+	closeAllNozzles();
+	if (sequence_running) {
+		popBlastStep(); // S3S2 goes on to the next step, ERROR clears the queue anyway
+	}
+	rgbSetLEDColor(LED_STATE::LED_BLASTING, RGB_CLR_IND::RGB_NO_ERROR);
+}
+
+bool transitionS3S2() { // BLASTING->EXTENDING, move on to the next blast sequence step (or the retract)
+	if (sequence_running && nozzleSequenceDone()) {
+		return true;
 	}
+	return false;
 }
 
 bool transitionS3S0() { // BLASTING->IDLE
-	if (blasting_complete) {
+	if (nozzleSequenceDone()) {
+		blasting_complete = true;
 		return true;
 	}
 	return false;
 }
 
-bool transitionS3S4() {} // BLASTING->ERROR
+bool transitionS3S4() { // BLASTING->ERROR, see the state definitions at the top
+	return false;
+}
 
 // ==================================================================================
 // **************************************
 // **** STATE4 (ERROR/UNKNOWN STATE) ****
 // **************************************
-void state4() {
-	// IDEAS:
-	//  - SET UP A "BLINKING" LOOP FOR ANY ERROR CONDITION SO 
-	//    THE RGB LED RELATING TO THE STATE THAT FAILED BLINKS
-
+void enterError() {
 	// TODO: HOW TO RECOVER? CYCLE POWER TO ARDUINO? FORCE RE-HOME MOTOR THEN MOVE BACK TO IDLE?
 
 	// ERROR/UNKNOWN
-	if (blasterStateMachine.executeOnce) {
-		_machine_state = ERROR;
-	}
+	_machine_state = ERROR;
+	sequence_running = false;
+	clearMotionQueue();
+	rgbBlinkErrorLEDs(); // the LED of the state that failed blinks, see serviceStatusLEDs()
 }
 
 // TODO: Might need transition from ERROR->HOME MOTOR here (then we can use HOME MOTOR to get back to IDLE)
-bool transitionS4S0() {} // ERROR->IDLE
+bool transitionS4S0() { return false; } // ERROR->IDLE
 
 
 // ==================================================================================
 // **************************************
 // **** STATE5 (TESTING STATE) ****
 // **************************************
-void state5() {
-	if (blasterStateMachine.executeOnce) {
-		rgbSetLEDColor(LED_STATE::LED_ERROR, RGB_CLR_IND::RGB_PROCESSING); // gonna piggy-back on the error LED for now
-		_machine_state = TESTING;
-		// TODO: RETHINK CYCLE TEST WITH SMC ACTUATOR
-		// ......maybe have it go 0->1->0->2->0->3->0->4.....->0->31, record the data points, and start over X times (????????)
-		//runCycleTest(test_cycles, requested_sixteenths_to_move);
+// cycle test: 0->1->0->2->0->3->0->4.....->0->31, test_cycles times.
+// every move is timed from DRIVE to the BUSY edge and the results are saved
+// as the actuator calibration table (ActuatorCalibration.h)
+void enterTesting() {
+	rgbSetLEDColor(LED_STATE::LED_ERROR, RGB_CLR_IND::RGB_PROCESSING); // gonna piggy-back on the error LED for now
+	_machine_state = TESTING;
+	testing_complete = false;
+	clearCalibrationAccumulators();
+	test_cycle = 0;
+	test_position = 0;
+	if (test_cycles <= 0) {
 		testing_complete = true;
-		rgbSetLEDColor(LED_STATE::LED_ERROR, RGB_CLR_IND::RGB_NO_ERROR); // gonna piggy-back on the error LED for now
+		return;
+	}
+	test_move = startActuatorMove(0); // back to 0 first, recorded like the others unless the start position is unknown
+}
+
+void runTesting() {
+	if (testing_complete) {
+		return;
+	}
+
+	MOVE_STATUS move_status = pollActuatorMove(test_move);
+	if (move_status == MOVE_TIMED_OUT || move_status == MOVE_REJECTED) {
+		blasterStateMachine.transitionTo(ERROR);
+		return;
+	}
+	if (move_status != MOVE_DONE) {
+		return;
 	}
+
+	recordCalibrationMove(actuatorLastMoveFrom(), actuatorPosition(), actuatorLastMoveTimeMicros() / 1000);
+
+	int next_position = 0;
+	if (actuatorPosition() == 0) {
+		if (++test_position >= SMC_POSITION_COUNT) {
+			test_position = 1;
+			++test_cycle;
+		}
+		if (test_cycle >= test_cycles) {
+			saveActuatorCalibration(test_cycle);
+			testing_complete = true;
+			rgbSetLEDColor(LED_STATE::LED_ERROR, RGB_CLR_IND::RGB_NO_ERROR); // gonna piggy-back on the error LED for now
+			return;
+		}
+		next_position = test_position;
+	}
+	test_move = startActuatorMove(next_position);
 }
 
 bool transitionS5S0() {
@@ -284,28 +386,154 @@ bool transitionS5S0() {
 	return false;
 }
 
+// ==================================================================================
+// ****************************************
+// **** STATE6 (EXTEND_BLASTING STATE) ****
+// ****************************************
+// EXTENDING and BLASTING run as two parallel regions of one state:
+// - motion region: the same move as EXTENDING, to requested_sixteenths_to_move
+// - blast region: the valve opens as soon as the actuator is estimated past
+//   overlap_blast_position (actuatorEstimatedPosition()) instead of waiting for BUSY,
+//   then runs the nozzle sequence for blast_on_timer like BLASTING
+// both regions share the EXTENDING and BLASTING error guards, and the BLASTING exit
+// hook closes the valve on any way out
+void enterExtendBlasting() {
+	enterExtending(); // starts the move, forces ERROR if not homed
+	_machine_state = EXTEND_BLASTING;
+	blasting_complete = false;
+	overlap_valve_opened = false;
+	blast_duration_ms = blast_on_timer;
+}
 
-void initializeStateMachineTransitions() {
-	// state 0 transitions
-	S0->addTransition(&transitionS0S1, S1);
-	S0->addTransition(&transitionS0S2, S2);
-	S0->addTransition(&transitionS0S3, S3);
-	S0->addTransition(&transitionS0S4, S4);
-	S0->addTransition(&transitionS0S5, S5);
-	// state 1 transitions
-	S1->addTransition(&transitionS1S0, S0);
-	S1->addTransition(&transitionS1S2, S2);
-	S1->addTransition(&transitionS1S4, S4);
-	// state 2 transitions
-	S2->addTransition(&transitionS2S0, S0);
-	S2->addTransition(&transitionS2S4, S4);
-	// state 3 transitions
-	S3->addTransition(&transitionS3S0, S0);
-	S3->addTransition(&transitionS3S4, S4);
-	// state 4 transitions
-	S4->addTransition(&transitionS4S0, S0);
-	// state 5 transition (JUST FOR TESTING)
-	S5->addTransition(&transitionS5S0, S0); // just for testing
+// the blast region may only open the valve while the motion region is healthy
+bool overlapSafeToBlast() {
+	if (!_homed_successfully) {
+		return false;
+	}
+	MOVE_STATUS move_status = pollActuatorMove(extend_move);
+	return move_status != MOVE_TIMED_OUT && move_status != MOVE_REJECTED;
+}
+
+bool overlapBlastPositionReached() {
+	if (extending_complete) {
+		return true; // covers a target short of the threshold and an uncalibrated actuator
+	}
+	uint8_t from = actuatorLastMoveFrom();
+	uint8_t target = actuatorMoveTarget(); // not requested_sixteenths_to_move, trigger1 can change that mid-move
+	uint8_t position = actuatorEstimatedPosition();
+	if (from == SMC_POSITION_UNKNOWN || target == SMC_POSITION_UNKNOWN || position == SMC_POSITION_UNKNOWN) {
+		return false; // wait for extending_complete
+	}
+	if (target >= from) { // extending, the threshold is crossed on the way out
+		return position >= min(overlap_blast_position, target);
+	}
+	// retracting to a shorter tip zone, the threshold is crossed on the way in
+	return position <= max(overlap_blast_position, target);
+}
+
+void runExtendBlasting() {
+	// motion region
+	runExtending();
+
+	// blast region
+	if (!overlap_valve_opened) {
+		if (overlapSafeToBlast() && overlapBlastPositionReached()) {
+			rgbSetLEDColor(LED_STATE::LED_BLASTING, RGB_CLR_IND::RGB_PROCESSING);
+			blast_time = millis();
+			overlap_valve_opened = true;
+			startNozzleSequence(currentShaft, blast_duration_ms);
+		}
+	}
+	else if (!blasting_complete) {
+		serviceNozzles();
+		if (nozzleSequenceDone()) {
+			rgbSetLEDColor(LED_STATE::LED_BLASTING, RGB_CLR_IND::RGB_NO_ERROR);
+			blasting_complete = true;
+		}
+	}
+}
+
+bool transitionS6S0() { // EXTEND_BLASTING->IDLE
+	if (extending_complete && blasting_complete) {
+		return true;
+	}
+	return false;
+}
+
+
+// ==================================================================================
+// **************************************
+// ****** state machine tables: *********
+// **************************************
+// transitions are grouped by source state, each state row points at its block
+// transitions per state, the first index of each block is derived from these
+// so adding a row only means bumping the count of its state
+constexpr uint8_t S0_TRANSITIONS = 7;
+constexpr uint8_t S1_TRANSITIONS = 3;
+constexpr uint8_t S2_TRANSITIONS = 3;
+constexpr uint8_t S3_TRANSITIONS = 3;
+constexpr uint8_t S4_TRANSITIONS = 1;
+constexpr uint8_t S5_TRANSITIONS = 1;
+constexpr uint8_t S6_TRANSITIONS = 3;
+
+constexpr uint8_t S0_FIRST = 0;
+constexpr uint8_t S1_FIRST = S0_FIRST + S0_TRANSITIONS;
+constexpr uint8_t S2_FIRST = S1_FIRST + S1_TRANSITIONS;
+constexpr uint8_t S3_FIRST = S2_FIRST + S2_TRANSITIONS;
+constexpr uint8_t S4_FIRST = S3_FIRST + S3_TRANSITIONS;
+constexpr uint8_t S5_FIRST = S4_FIRST + S4_TRANSITIONS;
+constexpr uint8_t S6_FIRST = S5_FIRST + S5_TRANSITIONS;
+constexpr uint8_t TRANSITION_COUNT = S6_FIRST + S6_TRANSITIONS;
+
+const TransitionDef blasterTransitions[] PROGMEM = {
+	// state 0 transitions (S0_FIRST)
+	{ &transitionS0S1, HOMING },
+	{ &transitionS0S2, EXTENDING },
+	{ &transitionS0S2Sequence, EXTENDING }, // must come before S0S3, both consume nbTrigger6
+	{ &transitionS0S6, EXTEND_BLASTING }, // must come before S0S3, both consume nbTrigger6
+	{ &transitionS0S3, BLASTING },
+	{ &transitionS0S4, ERROR },
+	{ &transitionS0S5, TESTING },
+	// state 1 transitions (S1_FIRST)
+	{ &transitionS1S0, IDLE },
+	{ &transitionS1S2, EXTENDING },
+	{ &transitionS1S4, ERROR },
+	// state 2 transitions (S2_FIRST)
+	{ &transitionS2S3, BLASTING },
+	{ &transitionS2S0, IDLE },
+	{ &transitionS2S4, ERROR },
+	// state 3 transitions (S3_FIRST)
+	{ &transitionS3S2, EXTENDING },
+	{ &transitionS3S0, IDLE },
+	{ &transitionS3S4, ERROR },
+	// state 4 transitions (S4_FIRST)
+	{ &transitionS4S0, IDLE },
+	// state 5 transition (S5_FIRST) (JUST FOR TESTING)
+	{ &transitionS5S0, IDLE },
+	// state 6 transitions (S6_FIRST)
+	{ &transitionS2S4, ERROR }, // shared with EXTENDING
+	{ &transitionS3S4, ERROR }, // shared with BLASTING
+	{ &transitionS6S0, IDLE },
+};
+static_assert(sizeof(blasterTransitions) / sizeof(blasterTransitions[0]) == TRANSITION_COUNT, "blasterTransitions rows don't match the S*_TRANSITIONS counts");
+
+// indexed by MACHINESTATE
+const StateDef blasterStates[] PROGMEM = {
+	//  entry                 run                 exit           first     count
+	{ &enterIdle,           NULL,               NULL,          S0_FIRST, S0_TRANSITIONS }, // IDLE
+	{ &enterHoming,         NULL,               NULL,          S1_FIRST, S1_TRANSITIONS }, // HOMING
+	{ &enterExtending,      &runExtending,      NULL,          S2_FIRST, S2_TRANSITIONS }, // EXTENDING
+	{ &enterBlasting,       &runBlasting,       &exitBlasting, S3_FIRST, S3_TRANSITIONS }, // BLASTING
+	{ &enterError,          NULL,               NULL,          S4_FIRST, S4_TRANSITIONS }, // ERROR
+	{ &enterTesting,        &runTesting,        NULL,          S5_FIRST, S5_TRANSITIONS }, // TESTING
+	{ &enterExtendBlasting, &runExtendBlasting, &exitBlasting, S6_FIRST, S6_TRANSITIONS }, // EXTEND_BLASTING
+};
+static_assert(sizeof(blasterStates) / sizeof(blasterStates[0]) == MACHINESTATE_COUNT, "blasterStates needs one row per MACHINESTATE");
+
+StaticStateMachine<MACHINESTATE_COUNT> blasterStateMachine(blasterStates, blasterTransitions);
+
+void initializeStateMachine() {
+	blasterStateMachine.begin(IDLE);
 }
 
 #endif
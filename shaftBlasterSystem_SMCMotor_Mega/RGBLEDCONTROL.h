@@ -6,26 +6,84 @@
 
 #define NUM_LEDS 5
 
-CRGB status_LEDs[NUM_LEDS];
+// every FastLED.show() sends the whole strip with interrupts disabled, which can
+// cost the Nextion bytes on NEXTION_SERIAL. rgbSetLEDColor() therefore only edits
+// the target frame, and serviceStatusLEDs() (called from loop()) sends it:
+// - at most once every LED_SERVICE_PERIOD_MS
+// - only if the frame differs from what was last shown
+// - not while Nextion bytes are waiting to be read, for up to LED_MAX_DEFER_MS.
+//   EasyNex leaves 1-2 byte leftovers in the buffer, so the wait has to end;
+//   a 5 LED frame takes ~150 us, less than one byte time at 57600 baud
+#define LED_SERVICE_PERIOD_MS 20
+#define LED_MAX_DEFER_MS 100
+#define LED_BLINK_HALF_PERIOD_MS 500
+
+CRGB status_LEDs[NUM_LEDS];  // the frame FastLED sends
+CRGB target_LEDs[NUM_LEDS];  // the frame we want
+uint8_t blink_LEDs = 0;      // bit per LED, blinking LEDs are off every other half period
+bool status_LEDs_dirty = false;
+unsigned long status_LEDs_last_service = 0;
 typedef enum { RGB_NO_ERROR = 0x008000, RGB_ERROR = 0xFF0000, RGB_PROCESSING = 0xF5F5F5, RGB_OFF = 0x000000 } RGB_CLR_IND; // Green / Red / WhiteSmoke (From FastLED Library)
 typedef enum { LED_IDLE = 0, LED_HOMING = 1, LED_EXTENDING = 2, LED_BLASTING = 3, LED_ERROR = 4 } LED_STATE;
 
 void rgbClearLEDS() {
 	for (int i = 0; i < NUM_LEDS; ++i) {
-		status_LEDs[i] = RGB_CLR_IND::RGB_OFF;
+		target_LEDs[i] = RGB_CLR_IND::RGB_OFF;
 	}
-	FastLED.show();
+	blink_LEDs = 0;
+	status_LEDs_dirty = true;
 }
 
 void rgbSetLEDColor(LED_STATE LED_NUM, RGB_CLR_IND LED_COLOR) {
 	rgbClearLEDS();
-	status_LEDs[LED_NUM] = LED_COLOR;
-	FastLED.show();
+	target_LEDs[LED_NUM] = LED_COLOR;
+}
+
+// blink every LED that is currently showing an error
+void rgbBlinkErrorLEDs() {
+	for (int i = 0; i < NUM_LEDS; ++i) {
+		if (target_LEDs[i] == CRGB(RGB_CLR_IND::RGB_ERROR)) blink_LEDs |= (1 << i);
+	}
+	status_LEDs_dirty = true;
+}
+
+void serviceStatusLEDs() {
+	unsigned long now = millis();
+	if (now - status_LEDs_last_service < LED_SERVICE_PERIOD_MS) {
+		return;
+	}
+	if (NEXTION_SERIAL.available() > 0 && now - status_LEDs_last_service < LED_SERVICE_PERIOD_MS + LED_MAX_DEFER_MS) {
+		return; // a Nextion frame is arriving, try again next loop()
+	}
+	status_LEDs_last_service = now;
+
+	if (!status_LEDs_dirty && blink_LEDs == 0) {
+		return;
+	}
+
+	bool blink_off = (now / LED_BLINK_HALF_PERIOD_MS) & 1;
+	bool changed = false;
+	for (int i = 0; i < NUM_LEDS; ++i) {
+		CRGB wanted = (blink_off && (blink_LEDs & (1 << i))) ? CRGB(RGB_CLR_IND::RGB_OFF) : target_LEDs[i];
+		if (status_LEDs[i] != wanted) {
+			status_LEDs[i] = wanted;
+			changed = true;
+		}
+	}
+	status_LEDs_dirty = false;
+
+	if (changed) {
+		FastLED.show();
+	}
 }
 
 void initializeRGBLEDStatusIndicator() {
 	FastLED.addLeds < WS2812B, LED_STATUS_INDICATOR_PIN, GRB >(status_LEDs, NUM_LEDS);
 	FastLED.setBrightness(200);
+	for (int i = 0; i < NUM_LEDS; ++i) {
+		status_LEDs[i] = RGB_CLR_IND::RGB_OFF;
+	}
+	FastLED.show();
 	rgbClearLEDS();
 }
 
@@ -0,0 +1,131 @@
+#ifndef STATIC_STATE_MACHINE_H
+#define STATIC_STATE_MACHINE_H
+
+#include <avr/pgmspace.h>
+
+// Heap-free state machine. The state and transition tables are const arrays
+// in flash (PROGMEM). The transitions of a state are one contiguous block of
+// the transition table, so run() only looks at the current state's guards
+// and finds its state row by index.
+//
+// run() order:
+// 1. a transition requested with transitionTo() (e.g. from an entry hook) is taken
+// 2. otherwise the current state's guards are checked in table order, first true one wins
+// 3. the current state's run hook is called
+// Taking a transition calls the old state's exit hook, then the new state's entry hook.
+//
+// Time spent in every state is recorded when the state is exited.
+
+typedef void (*StateHook)();
+typedef bool (*TransitionGuard)();
+
+struct StateDef {
+	StateHook onEntry; // NULL if not needed
+	StateHook onRun;   // NULL if not needed
+	StateHook onExit;  // NULL if not needed
+	uint8_t firstTransition;
+	uint8_t transitionCount;
+};
+
+struct TransitionDef {
+	TransitionGuard guard;
+	uint8_t target;
+};
+
+struct StateTiming {
+	unsigned long last_ms;  // time spent during the last visit
+	unsigned long total_ms; // time spent over all visits
+	uint16_t visits;
+};
+
+#define NO_STATE 0xFF
+
+template <uint8_t STATE_COUNT>
+class StaticStateMachine {
+public:
+	StaticStateMachine(const StateDef (&states)[STATE_COUNT], const TransitionDef* transitions)
+		: _states(states), _transitions(transitions) {}
+
+	void begin(uint8_t initial_state) {
+		for (uint8_t i = 0; i < STATE_COUNT; ++i) {
+			_timing[i].last_ms = 0;
+			_timing[i].total_ms = 0;
+			_timing[i].visits = 0;
+		}
+		_current = NO_STATE;
+		_pending = NO_STATE;
+		changeState(initial_state);
+	}
+
+	void run() {
+		if (_current == NO_STATE) {
+			return; // begin() was never called
+		}
+
+		if (_pending != NO_STATE) {
+			uint8_t target = _pending;
+			_pending = NO_STATE;
+			changeState(target);
+		}
+		else {
+			StateDef state;
+			memcpy_P(&state, &_states[_current], sizeof(StateDef));
+			for (uint8_t i = 0; i < state.transitionCount; ++i) {
+				TransitionDef transition;
+				memcpy_P(&transition, &_transitions[state.firstTransition + i], sizeof(TransitionDef));
+				if (transition.guard()) {
+					changeState(transition.target);
+					break;
+				}
+			}
+		}
+
+		if (_pending == NO_STATE) {
+			StateHook onRun = (StateHook)pgm_read_ptr(&_states[_current].onRun);
+			if (onRun) onRun();
+		}
+	}
+
+	// takes effect at the start of the next run()
+	void transitionTo(uint8_t state) {
+		if (state < STATE_COUNT) _pending = state;
+	}
+
+	uint8_t currentState() const {
+		return _current;
+	}
+
+	unsigned long timeInCurrentState() const {
+		return millis() - _entered_ms;
+	}
+
+	const StateTiming& stateTiming(uint8_t state) const {
+		return _timing[state];
+	}
+
+private:
+	void changeState(uint8_t target) {
+		unsigned long now = millis();
+		if (_current != NO_STATE) {
+			StateHook onExit = (StateHook)pgm_read_ptr(&_states[_current].onExit);
+			if (onExit) onExit();
+			StateTiming& timing = _timing[_current];
+			timing.last_ms = now - _entered_ms;
+			timing.total_ms += timing.last_ms;
+			timing.visits++;
+		}
+		_current = target;
+		_entered_ms = now;
+		StateHook onEntry = (StateHook)pgm_read_ptr(&_states[_current].onEntry);
+		if (onEntry) onEntry();
+	}
+
+	const StateDef* _states;           // PROGMEM
+	const TransitionDef* _transitions; // PROGMEM
+	StateTiming _timing[STATE_COUNT];
+	uint8_t _current = NO_STATE;
+	uint8_t _pending = NO_STATE;
+	unsigned long _entered_ms = 0;
+};
+
+#endif
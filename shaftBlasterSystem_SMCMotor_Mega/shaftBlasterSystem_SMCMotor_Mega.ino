@@ -3,18 +3,18 @@ shaftTypes currentShaft = graphite;
 
 #include <Arduino.h>
 #include <EasyNextionLibrary.h>
-#include <LinkedList.h>
-#include <StateMachine.h>
 #include <FastLED.h>
 // == custom includes ==
 #include "Mega2560PinDefs.h"
 #include "DelaySafe.h"
 #include "RGBLEDCONTROL.h"
 #include "MotorControl.h"
+#include "ActuatorCalibration.h"
 #include "ProgramStates.h"
+#include "NextionControl.h"
 
 // === NEXTION DEFINITIONS ===
-EasyNex myNex(Serial2); // NEXTION TO SERIAL 2
+EasyNex myNex(NEXTION_SERIAL); // NEXTION TO SERIAL 2
 
 // === GENERAL GLOBAL VARIABLE DEFINITIONS ===
 bool nbTrigger0 = false; // Reverse Actuator 1 Second Button Hit
@@ -34,8 +34,12 @@ extern MACHINESTATE _machine_state; // from ProgramStates.h
 
 void setup() {
 	initializePins();
+	initializeRGBLEDStatusIndicator();
+	loadActuatorCalibration();
+	loadBlastSequences();
+	loadNozzleConfig();
 	myNex.begin(57600);
-	initializeStateMachineTransitions();
+	initializeStateMachine();
 }
 
 
@@ -47,5 +51,7 @@ void loop() {
 
 	myNex.NextionListen();
 	blasterStateMachine.run();
+	serviceStatusLEDs(); // after NextionListen() so the Nextion RX buffer has just been drained
+	serviceEepromStore();
 	shaft_sense_pin_previous = shaft_sense_pin_current;
 }
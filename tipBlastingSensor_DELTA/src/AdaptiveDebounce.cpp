@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include "AdaptiveDebounce.h"
+
+#define TUNED_INPUT_COUNT 2
+static const INPUT_INDEX tuned_inputs[TUNED_INPUT_COUNT] = { INPUT_SHAFT_PRESENT, INPUT_DELTA_SIP };
+
+struct ChatterTracker
+{
+  bool in_burst;
+  unsigned long burst_start_us;
+  unsigned long last_edge_us;
+  unsigned long burst_max_gap_us;
+  uint16_t gap_us[CHATTER_HISTORY];   // longest gap inside each of the last bursts, capped
+  uint16_t burst_ms[CHATTER_HISTORY]; // length of each of the last bursts
+  uint8_t head;
+  uint8_t filled;
+};
+
+static ChatterTracker trackers[TUNED_INPUT_COUNT];
+static bool enabled = true;
+static uint16_t last_dropped = 0;
+static unsigned long blast_gap_ms = 0; // 0 = not calibrated, use the configured gap
+
+static int8_t trackerIndex(INPUT_INDEX input)
+{
+  for(uint8_t i = 0; i < TUNED_INPUT_COUNT; ++i) if(tuned_inputs[i] == input) return i;
+  return -1;
+}
+
+static uint16_t cap16(unsigned long value)
+{
+  return (value > 0xFFFF) ? 0xFFFF : value;
+}
+
+static uint16_t worstOf(const uint16_t* values, uint8_t count)
+{
+  uint16_t worst = 0;
+  for(uint8_t i = 0; i < count; ++i) if(values[i] > worst) worst = values[i];
+  return worst;
+}
+
+static bool allCalibrated()
+{
+  for(uint8_t i = 0; i < TUNED_INPUT_COUNT; ++i) if(trackers[i].filled < CHATTER_HISTORY) return false;
+  return true;
+}
+
+// settle times and the blast gap from the history, or the defaults while there is not enough of it
+static void apply()
+{
+  bool use_history = enabled && allCalibrated();
+  unsigned long worst_burst_ms = 0;
+  uint16_t worst_settle_ms = 0;
+
+  for(uint8_t i = 0; i < TUNED_INPUT_COUNT; ++i)
+  {
+    const ChatterTracker& t = trackers[i];
+    uint16_t settle_ms = defaultInputSettleTime(tuned_inputs[i]);
+    if(use_history)
+    {
+      unsigned long gap_us = worstOf(t.gap_us, CHATTER_HISTORY);
+      settle_ms = constrain((gap_us * 3 / 2) / 1000 + INPUT_FILTER_TICK_MS, ADAPTIVE_SETTLE_MIN_MS, ADAPTIVE_SETTLE_MAX_MS);
+      worst_burst_ms = max(worst_burst_ms, (unsigned long)worstOf(t.burst_ms, CHATTER_HISTORY));
+    }
+    setInputSettleTime(tuned_inputs[i], settle_ms);
+    worst_settle_ms = max(worst_settle_ms, inputSettleTime(tuned_inputs[i]));
+  }
+
+  blast_gap_ms = use_history ? max(worst_burst_ms * 2 + worst_settle_ms, (unsigned long)ADAPTIVE_BLAST_GAP_MIN_MS) : 0;
+}
+
+static void closeBurst(ChatterTracker& t)
+{
+  t.in_burst = false;
+  t.gap_us[t.head] = cap16(t.burst_max_gap_us);
+  t.burst_ms[t.head] = cap16((t.last_edge_us - t.burst_start_us) / 1000);
+  t.head = (t.head + 1) % CHATTER_HISTORY;
+  if(t.filled < CHATTER_HISTORY) t.filled++;
+  apply();
+}
+
+// every raw edge of the shaft sensor and the Delta SIP input, oldest first
+void adaptiveDebounceEdge(INPUT_INDEX input, unsigned long timestamp_us)
+{
+  int8_t index = trackerIndex(input);
+  if(index < 0) return;
+  ChatterTracker& t = trackers[index];
+
+  unsigned long gap_us = timestamp_us - t.last_edge_us;
+  if(t.in_burst && gap_us < CHATTER_BURST_GAP_MS * 1000UL)
+  {
+    if(gap_us > t.burst_max_gap_us) t.burst_max_gap_us = gap_us;
+  }
+  else
+  {
+    if(t.in_burst) closeBurst(t);
+    t.in_burst = true;
+    t.burst_start_us = timestamp_us;
+    t.burst_max_gap_us = 0;
+  }
+  t.last_edge_us = timestamp_us;
+}
+
+// closes bursts that have gone quiet. called every loop(), does nothing most of the time
+void serviceAdaptiveDebounce(uint16_t edge_events_dropped)
+{
+  if(edge_events_dropped != last_dropped)
+  {
+    // missing edges would make the inputs look cleaner than they are, start over
+    last_dropped = edge_events_dropped;
+    for(uint8_t i = 0; i < TUNED_INPUT_COUNT; ++i)
+    {
+      trackers[i].in_burst = false;
+      trackers[i].filled = 0;
+      trackers[i].head = 0;
+    }
+    apply();
+    return;
+  }
+
+  unsigned long now = micros();
+  for(uint8_t i = 0; i < TUNED_INPUT_COUNT; ++i)
+  {
+    ChatterTracker& t = trackers[i];
+    if(t.in_burst && now - t.last_edge_us >= CHATTER_BURST_GAP_MS * 1000UL) closeBurst(t);
+  }
+}
+
+// the gap between blast starts, never more than the recipe asks for
+unsigned long adaptiveBlastGap(unsigned long configured_ms)
+{
+  if(blast_gap_ms == 0 || blast_gap_ms > configured_ms) return configured_ms;
+  return blast_gap_ms;
+}
+
+void setAdaptiveDebounce(bool on)
+{
+  enabled = on;
+  apply();
+}
+
+bool adaptiveDebounceEnabled()
+{
+  return enabled;
+}
+
+bool adaptiveDebounceCalibrated()
+{
+  return allCalibrated();
+}
+
+uint16_t worstChatterGapUs(INPUT_INDEX input)
+{
+  int8_t index = trackerIndex(input);
+  if(index < 0) return 0;
+  return worstOf(trackers[index].gap_us, trackers[index].filled);
+}
+
+uint16_t worstChatterBurstMs(INPUT_INDEX input)
+{
+  int8_t index = trackerIndex(input);
+  if(index < 0) return 0;
+  return worstOf(trackers[index].burst_ms, trackers[index].filled);
+}
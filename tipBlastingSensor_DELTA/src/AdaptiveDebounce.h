@@ -0,0 +1,44 @@
+#ifndef ADAPTIVE_DEBOUNCE_H
+#define ADAPTIVE_DEBOUNCE_H
+
+#include <Arduino.h>
+#include "InputFilter.h"
+
+/*
+Debounce windows for the shaft sensor and the Delta SIP input that
+follow the chatter the inputs actually show.
+
+Every raw edge of the two inputs is handed in from the edge event queue.
+Edges closer together than CHATTER_BURST_GAP_MS belong to one burst
+(one real transition plus its bounce). Of the last CHATTER_HISTORY
+bursts of each input two figures are kept:
+ - the longest quiet time between two edges inside a burst. The input
+   filter's settle time has to be longer than that or the bounce gets
+   through, it is set to 1.5x plus a tick, within
+   ADAPTIVE_SETTLE_MIN_MS..ADAPTIVE_SETTLE_MAX_MS
+ - the longest burst. The gap between blast starts (debounce_timeout)
+   only has to outlast that, it is 2x plus the settle time, from
+   ADAPTIVE_BLAST_GAP_MIN_MS up to the recipe's debounce_timeout
+
+Until both inputs have CHATTER_HISTORY bursts, and again after the edge
+queue dropped events, the defaults and the recipe value are used.
+'A' on the debug port turns the adaptation off and on.
+*/
+
+#define CHATTER_BURST_GAP_MS      50
+#define CHATTER_HISTORY           8
+#define ADAPTIVE_SETTLE_MIN_MS    4
+#define ADAPTIVE_SETTLE_MAX_MS    40
+#define ADAPTIVE_BLAST_GAP_MIN_MS 50
+
+void adaptiveDebounceEdge(INPUT_INDEX input, unsigned long timestamp_us);
+void serviceAdaptiveDebounce(uint16_t edge_events_dropped);
+unsigned long adaptiveBlastGap(unsigned long configured_ms);
+
+void setAdaptiveDebounce(bool enabled);
+bool adaptiveDebounceEnabled();
+bool adaptiveDebounceCalibrated();
+uint16_t worstChatterGapUs(INPUT_INDEX input);
+uint16_t worstChatterBurstMs(INPUT_INDEX input);
+
+#endif
@@ -0,0 +1,195 @@
+#include <Arduino.h>
+#include "BlastCycle.h"
+#include "BlastRecipe.h"
+#include "ProductionLog.h"
+#include "BlastStats.h"
+#include "PulsedBlast.h"
+
+// from main.cpp
+extern bool enableSerialDebug;
+extern unsigned long previousBlastStartTime;
+extern unsigned long last_debounce_time;
+extern unsigned long totalBlastTime;
+void Start_Blasting();
+void Stop_Blasting();
+
+// a row never holds more transitions than this, so runBlastCycle()
+// evaluates at most this many guards per row
+#define CYCLE_MAX_TRANSITIONS 5
+
+typedef bool (*CycleGuard)(const CycleInputs& in);
+typedef void (*CycleAction)(const CycleInputs& in);
+
+struct CycleTransition
+{
+  CycleGuard guard;   // first guard that returns true wins
+  CycleAction action; // NULL if the transition has no side effects
+  CYCLE_STATE next;
+};
+
+struct CycleRow
+{
+  const CycleTransition* transitions;
+  uint8_t count;
+};
+
+template <size_t N>
+constexpr CycleRow cycleRow(const CycleTransition (&transitions)[N])
+{
+  static_assert(N <= CYCLE_MAX_TRANSITIONS, "too many transitions in one blast cycle row");
+  return CycleRow{ transitions, N };
+}
+
+static CYCLE_MODE cycle_mode = CYCLE_MODE_MANUAL;
+static CYCLE_STATE cycle_state = CYCLE_IDLE;
+static STOP_REASON stop_reason = STOP_COMPLETED;
+static unsigned long sip_arrived_ms = 0; // when the Delta handed over the shaft that is armed
+
+// ==================================================================================
+// ***************
+// *** GUARDS ****
+// ***************
+static bool always(const CycleInputs& in)                { return true; }
+static bool doorOpen(const CycleInputs& in)              { return in.door_open; }
+static bool readyForShaft(const CycleInputs& in)         { return !in.door_open && in.debounce_elapsed; }
+static bool shaftArrived(const CycleInputs& in)          { return in.shaft_arrived; }
+static bool shaftRemoved(const CycleInputs& in)          { return !in.shaft_present && (in.abort_policy & ABORT_ON_SHAFT_REMOVED); }
+static bool blastTimeElapsed(const CycleInputs& in)      { return in.blast_time_elapsed; }
+static bool deltaSipArrived(const CycleInputs& in)       { return in.delta_sip_arrived; }
+static bool deltaSipLost(const CycleInputs& in)          { return !in.delta_sip && (in.abort_policy & ABORT_ON_SIP_LOST); }
+static bool deltaUnavailable(const CycleInputs& in)      { return !in.delta_available && (in.abort_policy & ABORT_ON_DELTA_UNAVAILABLE); }
+
+static bool deltaReadyToBlast(const CycleInputs& in)
+{
+  // the dual check for a shaft may be redundant, probably just need shaft_present
+  return in.delta_available && in.debounce_elapsed && !in.door_open && in.delta_sip && in.shaft_present;
+}
+
+// ==================================================================================
+// ***************
+// *** ACTIONS ***
+// ***************
+static void armForDeltaShaft(const CycleInputs& in)
+{
+  // for aligning the local "shaft in place" logic to the external Delta robot "shaft in place" logic.
+  // the cycle only re-arms on the next SIP NO->YES edge, otherwise it would keep blasting over and over
+  if(enableSerialDebug) Serial.println("[INFO] ARMED BY DELTA SIP");
+  sip_arrived_ms = millis();
+}
+
+static void startBlast(const CycleInputs& in)
+{
+  Start_Blasting();
+  previousBlastStartTime = millis();
+  last_debounce_time = previousBlastStartTime;
+  if(cycle_mode == CYCLE_MODE_AUTO) recordSipToBlastLatency(previousBlastStartTime - sip_arrived_ms);
+}
+
+static void stopBlast(STOP_REASON reason, const char* msg)
+{
+  stop_reason = reason;
+  if(enableSerialDebug) Serial.println(msg);
+  Stop_Blasting();
+  unsigned long actual_ms = millis() - previousBlastStartTime;
+  recordBlastStop(reason, actual_ms, pulseDutyPercent(pulsePreset()));
+  logProductionCycle(previousBlastStartTime, totalBlastTime, actual_ms, reason, cycle_mode, activeClubType());
+}
+
+static void stopCompleted(const CycleInputs& in)     { stopBlast(STOP_COMPLETED, "[INFO] STOPPED BLASTING (success). BLAST TIME ACCOMPLISHED!"); }
+static void abortDoorOpen(const CycleInputs& in)     { stopBlast(STOP_DOOR_OPEN, "[INFO] STOPPED BLASTING. Reason: DOOR OPEN"); }
+static void abortSipLost(const CycleInputs& in)      { stopBlast(STOP_DELTA_SIP_LOST, "[INFO] STOPPED BLASTING. DELTA SHAFT NOT IN PLACE"); }
+static void abortUnavailable(const CycleInputs& in)  { stopBlast(STOP_DELTA_UNAVAILABLE, "[INFO] STOPPED BLASTING. DELTA MACHINE NOT AVAILABLE"); }
+static void abortShaftRemoved(const CycleInputs& in) { stopBlast(STOP_SHAFT_REMOVED, "[INFO] STOPPED BLASTING. PHYSICAL SHAFT REMOVED FROM SENSOR"); }
+
+// ==================================================================================
+// *************************
+// *** TRANSITION TABLES ***
+// *************************
+// rows are checked top to bottom, so the order of the stop conditions
+// in the BLASTING rows is also their priority
+
+// ---- MANUAL MODE ----
+static const CycleTransition manualIdle[] = {
+  { &readyForShaft,     NULL,               CYCLE_ARMED },
+};
+static const CycleTransition manualArmed[] = {
+  { &doorOpen,          NULL,               CYCLE_IDLE },
+  { &shaftArrived,      &startBlast,        CYCLE_BLASTING },
+};
+static const CycleTransition manualBlasting[] = {
+  { &doorOpen,          &abortDoorOpen,     CYCLE_ABORTED },
+  { &blastTimeElapsed,  &stopCompleted,     CYCLE_IDLE },
+  { &shaftRemoved,      &abortShaftRemoved, CYCLE_ABORTED },
+};
+static const CycleTransition manualAborted[] = {
+  { &always,            NULL,               CYCLE_IDLE },
+};
+
+// ---- AUTOMATIC MODE ----
+static const CycleTransition autoIdle[] = {
+  { &deltaSipArrived,   &armForDeltaShaft,  CYCLE_ARMED },
+};
+static const CycleTransition autoArmed[] = {
+  { &deltaReadyToBlast, &startBlast,        CYCLE_BLASTING },
+};
+static const CycleTransition autoBlasting[] = {
+  { &doorOpen,          &abortDoorOpen,     CYCLE_ABORTED },
+  { &deltaSipLost,      &abortSipLost,      CYCLE_ABORTED },
+  { &deltaUnavailable,  &abortUnavailable,  CYCLE_ABORTED },
+  { &blastTimeElapsed,  &stopCompleted,     CYCLE_IDLE },
+  { &shaftRemoved,      &abortShaftRemoved, CYCLE_ABORTED },
+};
+static const CycleTransition autoAborted[] = {
+  { &deltaSipArrived,   &armForDeltaShaft,  CYCLE_ARMED },
+  { &always,            NULL,               CYCLE_IDLE },
+};
+
+static const CycleRow cycleTable[CYCLE_MODE_COUNT][CYCLE_STATE_COUNT] = {
+  // IDLE                  ARMED                    BLASTING                    ABORTED
+  { cycleRow(manualIdle), cycleRow(manualArmed),  cycleRow(manualBlasting),  cycleRow(manualAborted) }, // MANUAL
+  { cycleRow(autoIdle),   cycleRow(autoArmed),    cycleRow(autoBlasting),    cycleRow(autoAborted) },   // AUTO
+};
+
+// ==================================================================================
+void resetBlastCycle(CYCLE_MODE mode)
+{
+  cycle_mode = mode;
+  cycle_state = CYCLE_IDLE;
+}
+
+// a transition with an action ends the call. one without an action (e.g.
+// IDLE->ARMED) only moves the state, so the new row is checked against the
+// same inputs right away, otherwise a shaft_arrived edge on the iteration
+// that armed the cycle would be lost. the edge flags only last one loop()
+void runBlastCycle(const CycleInputs& in)
+{
+  for(uint8_t pass = 0; pass < CYCLE_STATE_COUNT; ++pass)
+  {
+    const CycleRow& row = cycleTable[cycle_mode][cycle_state];
+    const CycleTransition* taken = NULL;
+
+    for(uint8_t i = 0; i < row.count; ++i)
+    {
+      if(row.transitions[i].guard(in))
+      {
+        taken = &row.transitions[i];
+        break;
+      }
+    }
+
+    if(taken == NULL) return;
+    if(taken->action) taken->action(in);
+    cycle_state = taken->next;
+    if(taken->action) return;
+  }
+}
+
+CYCLE_STATE currentBlastCycleState()
+{
+  return cycle_state;
+}
+
+STOP_REASON lastBlastStopReason()
+{
+  return stop_reason;
+}
@@ -0,0 +1,41 @@
+#ifndef BLAST_CYCLE_H
+#define BLAST_CYCLE_H
+
+#include <Arduino.h>
+
+/*
+=== Blast Cycle State Definitions ===
+IDLE     - not blasting, waiting for the cycle to be armed
+ARMED    - MANUAL: door closed and debounce elapsed, waiting for a shaft to arrive
+           AUTO:   Delta has handed over a shaft (SIP NO->YES), waiting for a safe blast
+BLASTING - relay is on, waiting for the blast time or a stop condition
+ABORTED  - blast was stopped early, lastBlastStopReason() says why
+
+Both modes share these states, only the transition rows differ.
+The rows live in BlastCycle.cpp.
+*/
+
+enum CYCLE_STATE { CYCLE_IDLE = 0, CYCLE_ARMED = 1, CYCLE_BLASTING = 2, CYCLE_ABORTED = 3, CYCLE_STATE_COUNT = 4 };
+enum CYCLE_MODE { CYCLE_MODE_MANUAL = 0, CYCLE_MODE_AUTO = 1, CYCLE_MODE_COUNT = 2 };
+enum STOP_REASON { STOP_COMPLETED = 0, STOP_DOOR_OPEN = 1, STOP_DELTA_SIP_LOST = 2, STOP_DELTA_UNAVAILABLE = 3, STOP_SHAFT_REMOVED = 4 };
+
+// everything the transition guards look at. filled in once per loop()
+struct CycleInputs
+{
+  bool door_open;
+  bool shaft_present;
+  bool shaft_arrived;      // NO SHAFT->SHAFT edge this iteration
+  bool delta_sip;
+  bool delta_sip_arrived;  // Delta SIP NO->YES edge this iteration
+  bool delta_available;    // Delta cell on, in auto and not faulted
+  bool debounce_elapsed;   // the blast gap (adaptiveBlastGap(debounce_timeout)) has passed since the last blast started
+  bool blast_time_elapsed; // totalBlastTime has passed since the current blast started
+  uint8_t abort_policy;    // ABORT_ON_* bits of the active recipe (BlastRecipe.h)
+};
+
+void resetBlastCycle(CYCLE_MODE mode);
+void runBlastCycle(const CycleInputs& in);
+CYCLE_STATE currentBlastCycleState();
+STOP_REASON lastBlastStopReason();
+
+#endif
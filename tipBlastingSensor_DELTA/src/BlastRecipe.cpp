@@ -0,0 +1,99 @@
+#include <Arduino.h>
+#include "BlastRecipe.h"
+#include "PulsedBlast.h"
+#include "ConfigStore.h"
+
+// from main.cpp
+extern unsigned long totalBlastTime;
+extern unsigned long totalBlastTime_min;
+extern unsigned long totalBlastTime_max;
+extern unsigned long debounce_timeout;
+extern unsigned long debounce_timeout_min;
+extern unsigned long debounce_timeout_max;
+
+static const BlastRecipe default_recipes[CLUB_TYPE_COUNT] = {
+  //  blast  debounce  pulse              abort
+  {   5000,  250,      PULSE_CONTINUOUS,  ABORT_ON_ALL }, // GRAPHITE
+  {   7000,  250,      PULSE_CONTINUOUS,  ABORT_ON_ALL }, // IRON
+  {   7000,  250,      PULSE_CONTINUOUS,  ABORT_ON_ALL }, // GENERIC
+};
+
+static const char* const club_type_names[CLUB_TYPE_COUNT] = { "GRAPHITE", "IRON", "GENERIC" };
+
+static CLUB_TYPE active_type = GENERIC;
+static uint8_t active_abort_policy = ABORT_ON_ALL;
+
+static bool recipeValid(const BlastRecipe& recipe)
+{
+  return recipe.blast_time_ms >= totalBlastTime_min && recipe.blast_time_ms <= totalBlastTime_max
+      && recipe.debounce_ms >= debounce_timeout_min && recipe.debounce_ms <= debounce_timeout_max
+      && recipe.pulse_preset < PULSE_PRESET_COUNT
+      && (recipe.abort_policy & ~ABORT_ON_ALL) == 0;
+}
+
+static BlastRecipe& storedRecipe(CLUB_TYPE type)
+{
+  return configRecord().recipes[type];
+}
+
+const BlastRecipe& defaultRecipe(CLUB_TYPE type)
+{
+  return default_recipes[type];
+}
+
+// the recipes come with the config record, loadConfig() has to run first
+void loadRecipes()
+{
+  CLUB_TYPE type = (CLUB_TYPE)configRecord().club_type;
+  selectRecipe(type < CLUB_TYPE_COUNT ? type : GENERIC);
+}
+
+void selectRecipe(CLUB_TYPE type)
+{
+  if(type >= CLUB_TYPE_COUNT) type = GENERIC;
+  if(!recipeValid(storedRecipe(type))) storedRecipe(type) = default_recipes[type];
+
+  const BlastRecipe& recipe = storedRecipe(type);
+  active_type = type;
+  totalBlastTime = recipe.blast_time_ms;
+  debounce_timeout = recipe.debounce_ms;
+  active_abort_policy = recipe.abort_policy;
+  setPulsePreset((PULSE_PRESET)recipe.pulse_preset);
+}
+
+// selection from the nextion, remembered across power cycles
+void chooseRecipe(CLUB_TYPE type)
+{
+  selectRecipe(type);
+  configRecord().club_type = active_type;
+  commitConfig();
+}
+
+// edits from the nextion buttons go into the recipe of the active club type
+void updateActiveRecipe(const BlastRecipe& recipe)
+{
+  if(!recipeValid(recipe)) return;
+  storedRecipe(active_type) = recipe;
+  commitConfig();
+  selectRecipe(active_type);
+}
+
+CLUB_TYPE activeClubType()
+{
+  return active_type;
+}
+
+const BlastRecipe& activeRecipe()
+{
+  return storedRecipe(active_type);
+}
+
+uint8_t activeAbortPolicy()
+{
+  return active_abort_policy;
+}
+
+const char* clubTypeName(CLUB_TYPE type)
+{
+  return (type < CLUB_TYPE_COUNT) ? club_type_names[type] : "?";
+}
@@ -0,0 +1,45 @@
+#ifndef BLAST_RECIPE_H
+#define BLAST_RECIPE_H
+
+#include <Arduino.h>
+
+/*
+Blast recipes, one per club type, stored in the config record (ConfigStore.h).
+A recipe holds the blast time, the pulse preset (PulsedBlast.h), the
+minimum gap between blast starts and which stop conditions abort a blast.
+
+selectRecipe() resolves the recipe once: it writes totalBlastTime and
+debounce_timeout, sets the pulse preset and caches the abort policy, so
+loop() only ever reads plain variables. The recipe is picked from the
+Nextion (trigger3) or, in AUTO mode, from the two Delta recipe inputs
+when the Delta hands over a shaft.
+*/
+
+enum CLUB_TYPE { GRAPHITE = 0, IRON = 1, GENERIC = 2, CLUB_TYPE_COUNT = 3 };
+
+// which stop conditions abort a blast. an open door always does
+#define ABORT_ON_SIP_LOST          0x01
+#define ABORT_ON_DELTA_UNAVAILABLE 0x02
+#define ABORT_ON_SHAFT_REMOVED     0x04
+#define ABORT_ON_ALL               (ABORT_ON_SIP_LOST | ABORT_ON_DELTA_UNAVAILABLE | ABORT_ON_SHAFT_REMOVED)
+
+struct BlastRecipe
+{
+  uint16_t blast_time_ms;
+  uint16_t debounce_ms;
+  uint8_t pulse_preset; // PULSE_PRESET
+  uint8_t abort_policy; // ABORT_ON_* bits
+};
+
+void loadRecipes();
+void selectRecipe(CLUB_TYPE type);
+void chooseRecipe(CLUB_TYPE type);
+void updateActiveRecipe(const BlastRecipe& recipe);
+
+CLUB_TYPE activeClubType();
+const BlastRecipe& activeRecipe();
+uint8_t activeAbortPolicy();
+const char* clubTypeName(CLUB_TYPE type);
+const BlastRecipe& defaultRecipe(CLUB_TYPE type);
+
+#endif
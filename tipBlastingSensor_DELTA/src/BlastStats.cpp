@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <math.h>
+#include "BlastStats.h"
+
+#define STOP_REASON_COUNT (STOP_SHAFT_REMOVED + 1)
+
+static uint16_t histogram[BLAST_HISTOGRAM_BINS];
+static uint16_t stop_counts[STOP_REASON_COUNT];
+static unsigned long relay_on_seconds = 0;
+static uint16_t relay_on_ms = 0; // remainder below a second
+static LatencyStats latency;
+
+// counters stop at their maximum instead of wrapping
+static void saturatingIncrement(uint16_t& counter)
+{
+  if(counter < 0xFFFF) counter++;
+}
+
+void resetBlastStats()
+{
+  for(uint8_t i = 0; i < BLAST_HISTOGRAM_BINS; ++i) histogram[i] = 0;
+  for(uint8_t i = 0; i < STOP_REASON_COUNT; ++i) stop_counts[i] = 0;
+  relay_on_seconds = 0;
+  relay_on_ms = 0;
+  latency.count = 0;
+  latency.mean_ms = 0;
+  latency.m2 = 0;
+  latency.max_ms = 0;
+}
+
+// duty_percent is the share of the blast the relay was actually on, 100 for a continuous blast
+void recordBlastStop(STOP_REASON reason, unsigned long actual_ms, uint8_t duty_percent)
+{
+  unsigned long bin = actual_ms / BLAST_HISTOGRAM_BIN_MS;
+  saturatingIncrement(histogram[(bin < BLAST_HISTOGRAM_BINS) ? bin : BLAST_HISTOGRAM_BINS - 1]);
+  if(reason < STOP_REASON_COUNT) saturatingIncrement(stop_counts[reason]);
+
+  unsigned long on_ms = relay_on_ms + (actual_ms * duty_percent) / 100;
+  relay_on_seconds += on_ms / 1000;
+  relay_on_ms = on_ms % 1000;
+}
+
+void recordSipToBlastLatency(unsigned long latency_ms)
+{
+  // halve the weight of the history before the count wraps, like the loop profiler does
+  if(latency.count == 0xFFFF)
+  {
+    latency.count >>= 1;
+    latency.m2 /= 2;
+  }
+  latency.count++;
+  float delta = latency_ms - latency.mean_ms;
+  latency.mean_ms += delta / latency.count;
+  latency.m2 += delta * (latency_ms - latency.mean_ms);
+  if(latency_ms > latency.max_ms) latency.max_ms = latency_ms;
+}
+
+uint16_t blastHistogramBin(uint8_t bin)
+{
+  return (bin < BLAST_HISTOGRAM_BINS) ? histogram[bin] : 0;
+}
+
+uint16_t stopReasonCount(STOP_REASON reason)
+{
+  return (reason < STOP_REASON_COUNT) ? stop_counts[reason] : 0;
+}
+
+unsigned long relayOnSeconds()
+{
+  return relay_on_seconds;
+}
+
+const LatencyStats& sipToBlastLatency()
+{
+  return latency;
+}
+
+// sample standard deviation, 0 until there are two samples
+float latencyStdDevMs(const LatencyStats& stats)
+{
+  if(stats.count < 2) return 0;
+  return sqrt(stats.m2 / (stats.count - 1));
+}
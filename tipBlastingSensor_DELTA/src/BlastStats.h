@@ -0,0 +1,40 @@
+#ifndef BLAST_STATS_H
+#define BLAST_STATS_H
+
+#include <Arduino.h>
+#include "BlastCycle.h"
+
+/*
+Running statistics of the blast cycles since boot, fixed size and
+updated once per stop (and once per blast start for the latency):
+ - a histogram of the actual blast durations
+ - how many cycles stopped for each STOP_REASON
+ - relay-on time, scaled by the pulse preset's duty cycle, as a proxy
+   for the air used
+ - mean and variance of the Delta SIP NO->YES to blast start latency
+   (Welford's method, AUTO mode only)
+Shown on the stats page of the nextion and printed with 's'.
+*/
+
+#define BLAST_HISTOGRAM_BINS   16
+#define BLAST_HISTOGRAM_BIN_MS 2000 // the last bin also takes everything longer
+
+struct LatencyStats
+{
+  uint16_t count;
+  float mean_ms;
+  float m2;       // sum of squared differences from the mean
+  unsigned long max_ms;
+};
+
+void resetBlastStats();
+void recordBlastStop(STOP_REASON reason, unsigned long actual_ms, uint8_t duty_percent);
+void recordSipToBlastLatency(unsigned long latency_ms);
+
+uint16_t blastHistogramBin(uint8_t bin);
+uint16_t stopReasonCount(STOP_REASON reason);
+unsigned long relayOnSeconds();
+const LatencyStats& sipToBlastLatency();
+float latencyStdDevMs(const LatencyStats& stats);
+
+#endif
@@ -0,0 +1,167 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "ConfigStore.h"
+#include "EepromLayout.h"
+#include "EepromWriter.h"
+
+#define CONFIG_SELECT_A 'A'
+#define CONFIG_SELECT_B 'B'
+
+static_assert(sizeof(ConfigRecord) <= CONFIG_COPY_SIZE, "ConfigRecord outgrew its EEPROM copy");
+
+// what main.cpp kept at address 0 before the config records
+struct LegacyContents
+{
+  uint32_t total_shaft_count;
+  int16_t club_type;
+  uint32_t saved_on_time;
+};
+
+static ConfigRecord config;
+static uint8_t active_copy = 0; // 0 = A, 1 = B
+
+static uint16_t copyAddress(uint8_t copy)
+{
+  return copy ? CONFIG_COPY_B_ADDRESS : CONFIG_COPY_A_ADDRESS;
+}
+
+static uint16_t recordCrc(const ConfigRecord& record)
+{
+  const uint8_t* bytes = (const uint8_t*)&record;
+  uint16_t crc = 0xFFFF;
+  for(uint8_t i = sizeof(record.crc); i < sizeof(ConfigRecord); ++i) crc = _crc16_update(crc, bytes[i]);
+  return crc;
+}
+
+// reads one copy into out. the CRC runs over the length the writer used, so a
+// record from an older (shorter) or newer (longer) firmware still checks out.
+// bytes this firmware does not know about are skipped, missing ones stay as they were
+static bool readCopy(uint8_t copy, ConfigRecord& out)
+{
+  uint16_t address = copyAddress(copy);
+  uint8_t length = EEPROM.read(address + offsetof(ConfigRecord, length));
+  if(length <= offsetof(ConfigRecord, length) || length > CONFIG_COPY_SIZE) return false;
+
+  uint16_t stored_crc = EEPROM.read(address) | (EEPROM.read(address + 1) << 8);
+  uint16_t crc = 0xFFFF;
+  uint8_t* bytes = (uint8_t*)&out;
+  for(uint8_t i = sizeof(out.crc); i < length; ++i)
+  {
+    uint8_t value = EEPROM.read(address + i);
+    crc = _crc16_update(crc, value);
+    if(i < sizeof(ConfigRecord)) bytes[i] = value;
+  }
+  out.crc = stored_crc;
+  return crc == stored_crc;
+}
+
+static void defaultConfig(ConfigRecord& c)
+{
+  c.club_type = GENERIC;
+  for(uint8_t i = 0; i < CLUB_TYPE_COUNT; ++i) c.recipes[i] = defaultRecipe((CLUB_TYPE)i);
+}
+
+// version 0 = the EEPROM_CONTENTS layout from before the config records
+static void migrateFromLegacy(ConfigRecord& c)
+{
+  LegacyContents legacy;
+  EEPROM.get(EEPROM_CONTENTS_START_ADDRESS, legacy);
+
+  defaultConfig(c);
+  bool legacy_valid = legacy.saved_on_time <= 30000; // uninitialized EEPROM is all 1's
+  if(legacy_valid && legacy.club_type >= 0 && legacy.club_type < CLUB_TYPE_COUNT) c.club_type = legacy.club_type;
+
+  if(legacy_valid)
+  {
+    // keep the time the machine was tuned to
+    for(uint8_t i = 0; i < CLUB_TYPE_COUNT; ++i) c.recipes[i].blast_time_ms = legacy.saved_on_time;
+  }
+}
+
+// brings a record written by an older firmware up to CONFIG_VERSION.
+// version 1 is the first one, new fields get their defaults here, e.g.
+// if(c.version < 2) c.new_field = NEW_FIELD_DEFAULT;
+static void upgradeConfig(ConfigRecord& c)
+{
+  c.version = CONFIG_VERSION;
+  c.length = sizeof(ConfigRecord);
+}
+
+// returns false if no stored copy was valid and the config had to be rebuilt
+bool loadConfig()
+{
+  eepromFlushWrites();
+
+  defaultConfig(config); // fields an older record does not have keep their defaults
+  ConfigRecord other = config;
+
+  uint8_t selector = EEPROM.read(CONFIG_SELECT_ADDRESS);
+  uint8_t selected = (selector == CONFIG_SELECT_B) ? 1 : 0;
+  bool selected_valid = (selector == CONFIG_SELECT_A || selector == CONFIG_SELECT_B) && readCopy(selected, config);
+
+  if(!selected_valid)
+  {
+    // torn selector or a bad copy: take whichever copy is valid, the newer one if both are
+    defaultConfig(config);
+    other = config;
+    bool a_valid = readCopy(0, config);
+    bool b_valid = readCopy(1, other);
+    if(b_valid && (!a_valid || (int8_t)(other.sequence - config.sequence) > 0))
+    {
+      config = other;
+      selected = 1;
+    }
+    else if(!a_valid)
+    {
+      migrateFromLegacy(config);
+      config.sequence = 0;
+      active_copy = 1; // so the first commit goes to copy A
+      upgradeConfig(config);
+      commitConfig();
+      return false;
+    }
+    else selected = 0;
+  }
+
+  active_copy = selected;
+  if(config.version != CONFIG_VERSION || config.length != sizeof(ConfigRecord))
+  {
+    upgradeConfig(config);
+    commitConfig();
+  }
+  return true;
+}
+
+void commitConfig()
+{
+  uint8_t target = active_copy ^ 1;
+  config.version = CONFIG_VERSION;
+  config.length = sizeof(ConfigRecord);
+  config.sequence++;
+  config.crc = recordCrc(config);
+
+  eepromPutAsync(copyAddress(target), config);
+  // queued behind the copy, so the selector only flips once the copy is complete
+  uint8_t selector = target ? CONFIG_SELECT_B : CONFIG_SELECT_A;
+  eepromPutAsync(CONFIG_SELECT_ADDRESS, selector);
+  active_copy = target;
+}
+
+ConfigRecord& configRecord()
+{
+  return config;
+}
+
+char configCopyName()
+{
+  return active_copy ? CONFIG_SELECT_B : CONFIG_SELECT_A;
+}
+
+// the all-time shaft count from before the shaft counter log, 0 on a new board
+unsigned long legacyShaftCount()
+{
+  LegacyContents legacy;
+  EEPROM.get(EEPROM_CONTENTS_START_ADDRESS, legacy);
+  return (legacy.saved_on_time <= 30000) ? legacy.total_shaft_count : 0;
+}
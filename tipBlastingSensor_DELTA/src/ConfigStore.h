@@ -0,0 +1,48 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "BlastRecipe.h"
+
+/*
+Settings that survive a power cycle, kept as two copies (A/B) of one
+record plus a selector byte that says which copy is current.
+
+commitConfig() writes the whole record into the copy that is NOT
+current, then flips the selector byte. The background writer
+(EepromWriter.h) keeps that order, so a reset at any point leaves either
+the old or the new record selected, never a half written one.
+
+Boot reads the selector and checks that copy's CRC. If the selector is
+torn or its copy is bad, the other copy is used. If neither copy is
+valid, the record is built from the layout the firmware used before
+(EEPROM_CONTENTS) or from defaults. That is two record reads at most.
+
+Schema changes: fields are only ever added at the end, CONFIG_VERSION is
+bumped and upgradeConfig() in ConfigStore.cpp fills the new field for
+records written by an older version. "length" tells how much of the
+record the writer knew about.
+*/
+
+#define CONFIG_VERSION 1
+
+struct ConfigRecord
+{
+  // header, the same for every version
+  uint16_t crc;      // over every byte after it, up to length
+  uint8_t version;
+  uint8_t sequence;  // +1 per commit
+  uint8_t length;    // sizeof(ConfigRecord) of the firmware that wrote it
+  // version 1
+  uint8_t club_type; // CLUB_TYPE picked on the nextion
+  BlastRecipe recipes[CLUB_TYPE_COUNT];
+};
+
+bool loadConfig();
+void commitConfig();
+ConfigRecord& configRecord();
+char configCopyName();
+
+unsigned long legacyShaftCount();
+
+#endif
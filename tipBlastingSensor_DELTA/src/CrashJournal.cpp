@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "CrashJournal.h"
+#include "EepromLayout.h"
+#include "EepromWriter.h"
+
+static_assert(CRASH_SLOT_COUNT * sizeof(CrashRecord) <= CRASH_JOURNAL_END_ADDRESS - CRASH_JOURNAL_START_ADDRESS, "crash journal outgrew its EEPROM area");
+
+static uint8_t head_slot = CRASH_SLOT_COUNT - 1; // newest record, the next crash goes into the slot after it
+static uint8_t head_sequence = 0xFF;             // so the first crash ever is sequence 0
+static uint8_t record_count = 0;                 // valid records in the ring at boot
+
+static uint8_t recordCrc(const CrashRecord& record)
+{
+  const uint8_t* bytes = (const uint8_t*)&record;
+  uint8_t crc = 0;
+  for(uint8_t i = 0; i < offsetof(CrashRecord, crc); ++i) crc = _crc8_ccitt_update(crc, bytes[i]);
+  return crc;
+}
+
+static int slotAddress(uint8_t slot)
+{
+  return CRASH_JOURNAL_START_ADDRESS + slot * sizeof(CrashRecord);
+}
+
+static bool readSlot(uint8_t slot, CrashRecord& out)
+{
+  EEPROM.get(slotAddress(slot), out);
+  return out.crc == recordCrc(out);
+}
+
+void loadCrashJournal()
+{
+  eepromFlushWrites();
+
+  CrashRecord current;
+  CrashRecord next;
+  record_count = 0;
+  for(uint8_t i = 0; i < CRASH_SLOT_COUNT; ++i)
+  {
+    if(readSlot(i, current)) record_count++;
+  }
+
+  bool current_valid = readSlot(0, current);
+  for(uint8_t i = 0; i < CRASH_SLOT_COUNT; ++i)
+  {
+    uint8_t n = (i + 1) % CRASH_SLOT_COUNT;
+    bool next_valid = readSlot(n, next);
+    if(current_valid && (!next_valid || next.sequence != (uint8_t)(current.sequence + 1)))
+    {
+      head_slot = i;
+      head_sequence = current.sequence;
+      return;
+    }
+    current = next;
+    current_valid = next_valid;
+  }
+
+  // no valid record at all
+  head_slot = CRASH_SLOT_COUNT - 1;
+  head_sequence = 0xFF;
+}
+
+// called from ISR(WDT_vect), the record is written in the background (EepromWriter.h)
+void recordCrash(uint8_t flags, uint8_t inputs, uint8_t cycle_state)
+{
+  CrashRecord record;
+  record.sequence = head_sequence + 1;
+  record.section = currentLoopSection();
+  record.flags = flags;
+  record.inputs = inputs;
+  record.cycle_state = cycle_state;
+  record.stack_pointer = SP;
+  record.stalled_ms = openIterationMillis();
+  for(uint8_t i = 0; i < LOOP_HISTORY_COUNT; ++i) record.loop_ms[i] = recentIterationMillis(i);
+  record.crc = recordCrc(record);
+
+  uint8_t target = (head_slot + 1) % CRASH_SLOT_COUNT;
+  eepromPutAsync(slotAddress(target), record);
+  head_slot = target;
+  head_sequence = record.sequence;
+  if(record_count < CRASH_SLOT_COUNT) record_count++;
+}
+
+uint8_t crashRecordCount()
+{
+  return record_count;
+}
+
+// age 0 = the newest crash. false if there is no such record (or it is torn)
+bool crashRecord(uint8_t age, CrashRecord& out)
+{
+  if(age >= record_count) return false;
+  eepromFlushWrites(); // a record that is still being written reads back torn
+  uint8_t slot = (head_slot + CRASH_SLOT_COUNT - age) % CRASH_SLOT_COUNT;
+  return readSlot(slot, out) && out.sequence == (uint8_t)(head_sequence - age);
+}
@@ -0,0 +1,46 @@
+#ifndef CRASH_JOURNAL_H
+#define CRASH_JOURNAL_H
+
+#include <Arduino.h>
+#include "LoopProfiler.h"
+
+/*
+What loop() was doing when the watchdog ran out. ISR(WDT_vect) fills in
+one CrashRecord and queues it into a ring of CRASH_SLOT_COUNT slots
+(EepromWriter.h), in the 250 ms before the watchdog resets the board
+(enough to drain a full write buffer, see ISR(WDT_vect)).
+The next boot reads the ring back, newest first, for the Serial port
+('j') and the hidden diagnostics page.
+
+The newest slot is found the same way as in the shaft counter log: the
+valid slot whose successor is not valid or does not continue its
+sequence number.
+*/
+
+#define CRASH_SLOT_COUNT 4
+
+// what main.cpp knew about the machine when the watchdog fired
+#define CRASH_FLAG_BLASTING    0x01 // machineCurrentlyBlasting
+#define CRASH_FLAG_RELAY_ON    0x02
+#define CRASH_FLAG_MANUAL_MODE 0x04
+#define CRASH_FLAG_EEPROM_BUSY 0x08 // background writer had records queued
+
+struct CrashRecord
+{
+  uint8_t sequence;      // +1 per crash
+  uint8_t section;       // LOOP_SECTION that was open, SECTION_NONE between iterations
+  uint8_t flags;         // CRASH_FLAG_*
+  uint8_t inputs;        // filtered IN_* bits of the last finished iteration
+  uint8_t cycle_state;   // CYCLE_STATE
+  uint16_t stack_pointer; // inside the watchdog interrupt
+  uint16_t stalled_ms;   // how long the iteration that never finished had run
+  uint16_t loop_ms[LOOP_HISTORY_COUNT]; // the iterations before it, newest first
+  uint8_t crc;
+};
+
+void loadCrashJournal();
+void recordCrash(uint8_t flags, uint8_t inputs, uint8_t cycle_state);
+uint8_t crashRecordCount();
+bool crashRecord(uint8_t age, CrashRecord& out);
+
+#endif
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "EdgeEventQueue.h"
+
+static_assert((EDGE_QUEUE_SIZE & (EDGE_QUEUE_SIZE - 1)) == 0, "EDGE_QUEUE_SIZE must be a power of 2");
+
+#define SHAFT_SENSE_INT_PIN 2 // must match SHAFT_SENSE_PIN in main.cpp
+
+static EdgeEvent queue[EDGE_QUEUE_SIZE];
+static volatile uint8_t head = 0; // next slot to write, only changed by the producer
+static volatile uint8_t tail = 0; // next slot to read, only changed by the consumer
+static volatile uint16_t dropped = 0;
+
+void pushEdgeEvent(uint8_t input, uint8_t flags)
+{
+  uint8_t h = head;
+  uint8_t next = (h + 1) & (EDGE_QUEUE_SIZE - 1);
+  if(next == tail)
+  {
+    // full, keep the older events so ordering stays intact
+    if(dropped != 0xFFFF) dropped++;
+    return;
+  }
+
+  queue[h].timestamp_us = micros();
+  queue[h].input = input;
+  queue[h].flags = flags;
+  __asm__ __volatile__("" ::: "memory");
+  head = next; // publish only after the slot is filled
+}
+
+bool popEdgeEvent(EdgeEvent& ev)
+{
+  uint8_t t = tail;
+  if(t == head) return false;
+
+  ev = queue[t];
+  __asm__ __volatile__("" ::: "memory");
+  tail = (t + 1) & (EDGE_QUEUE_SIZE - 1); // release the slot only after it was copied
+  return true;
+}
+
+uint16_t edgeEventsDropped()
+{
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    count = dropped;
+  }
+  return count;
+}
+
+static void shaftSenseEdgeISR()
+{
+  // LOW = SHAFT PRESENT
+  pushEdgeEvent(INPUT_SHAFT_PRESENT, (PINE & _BV(4)) ? 0 : EDGE_RISING);
+}
+
+void initEdgeEventCapture()
+{
+  attachInterrupt(digitalPinToInterrupt(SHAFT_SENSE_INT_PIN), shaftSenseEdgeISR, CHANGE);
+}
@@ -0,0 +1,37 @@
+#ifndef EDGE_EVENT_QUEUE_H
+#define EDGE_EVENT_QUEUE_H
+
+#include <Arduino.h>
+#include "InputFilter.h"
+
+/*
+Timestamped input transitions handed from interrupts to loop().
+
+Producers (interrupt context only):
+- INT4 on SHAFT_SENSE_PIN: every raw shaft sensor edge, stamped in its own ISR
+- the InputFilter tick: raw edges of the other inputs (1 ms resolution) and
+  every debounced state change (EDGE_SETTLED)
+
+AVR interrupts do not nest, so the producers never run at the same time and
+the ring is single-producer/single-consumer. Head and tail are single bytes,
+so neither side has to block interrupts.
+*/
+
+#define EDGE_QUEUE_SIZE 32 // must be a power of 2
+
+#define EDGE_RISING  0x01 // logical input is true after this edge (see IN_* bits)
+#define EDGE_SETTLED 0x02 // debounced state change rather than a raw pin edge
+
+struct EdgeEvent
+{
+  unsigned long timestamp_us; // micros() when the edge was seen
+  uint8_t input;              // INPUT_INDEX
+  uint8_t flags;
+};
+
+void initEdgeEventCapture();
+void pushEdgeEvent(uint8_t input, uint8_t flags); // interrupt context only
+bool popEdgeEvent(EdgeEvent& ev);                 // loop() only
+uint16_t edgeEventsDropped();
+
+#endif
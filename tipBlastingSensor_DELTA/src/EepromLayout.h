@@ -0,0 +1,39 @@
+#ifndef EEPROM_LAYOUT_H
+#define EEPROM_LAYOUT_H
+
+/*
+Where everything lives in the ATmega2560's 4 KB EEPROM.
+
+0x000 - 0x00F  EEPROM_CONTENTS of older firmware. only read: to seed the shaft
+               counter log and to migrate the settings into the config records
+0x010 - 0x03F  free
+0x040          config copy selector (ConfigStore.cpp), 'A' or 'B'
+0x050 - 0x07F  config record copy A
+0x080 - 0x0AF  config record copy B
+0x0B0 - 0x0B4  power-fail counter delta (PowerFailMonitor.cpp)
+0x0B5 - 0x0BF  free
+0x0C0 - 0x10F  crash journal (CrashJournal.cpp), 4 slots of 18 bytes
+0x110 - 0x3FF  free
+0x400 - 0x7FF  shaft counter log (ShaftCounterLog.cpp), 128 slots of 8 bytes
+0x800 - 0xFFF  production log (ProductionLog.cpp), 32 blocks of 64 bytes
+*/
+
+#define EEPROM_CONTENTS_START_ADDRESS 0x000
+
+#define CONFIG_SELECT_ADDRESS 0x040
+#define CONFIG_COPY_A_ADDRESS 0x050
+#define CONFIG_COPY_B_ADDRESS 0x080
+#define CONFIG_COPY_SIZE      0x030
+
+#define POWER_FAIL_SLOT_ADDRESS 0x0B0
+
+#define CRASH_JOURNAL_START_ADDRESS 0x0C0
+#define CRASH_JOURNAL_END_ADDRESS   0x110 // one past the last byte
+
+#define SHAFT_COUNTER_LOG_START_ADDRESS 0x400
+#define SHAFT_COUNTER_LOG_END_ADDRESS   0x800 // one past the last byte
+
+#define PRODUCTION_LOG_START_ADDRESS 0x800
+#define PRODUCTION_LOG_END_ADDRESS   0x1000 // one past the last byte
+
+#endif
@@ -0,0 +1,144 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "EepromWriter.h"
+
+struct WriteJob
+{
+  uint16_t address;
+  uint8_t length;
+  EepromTicket ticket;
+};
+
+// everything below is shared with ISR(EE_READY_vect). the main side only
+// touches it with interrupts blocked
+static WriteJob jobs[EEPROM_WRITE_QUEUE_SIZE];
+static volatile uint8_t job_head = 0;
+static volatile uint8_t job_count = 0;
+static volatile uint8_t job_progress = 0; // bytes of jobs[job_head] handled so far
+
+static uint8_t data_buffer[EEPROM_WRITE_BUFFER_SIZE];
+static volatile uint8_t data_head = 0;
+static volatile uint8_t data_count = 0;
+
+static volatile EepromTicket tickets_issued = 0;
+static volatile EepromTicket tickets_completed = 0;
+static volatile uint16_t writes_dropped = 0;
+
+// fires whenever EEPE is clear, so it also starts the first byte of a fresh queue
+ISR(EE_READY_vect)
+{
+  while(job_count > 0)
+  {
+    WriteJob& job = jobs[job_head];
+    if(job_progress == job.length)
+    {
+      tickets_completed = job.ticket;
+      job_head = (job_head + 1) % EEPROM_WRITE_QUEUE_SIZE;
+      job_count--;
+      job_progress = 0;
+      continue;
+    }
+
+    uint16_t address = job.address + job_progress;
+    uint8_t value = data_buffer[data_head];
+    data_head = (data_head + 1) % EEPROM_WRITE_BUFFER_SIZE;
+    data_count--;
+    job_progress++;
+
+    EEAR = address;
+    EECR |= _BV(EERE);
+    if(EEDR != value)
+    {
+      EEDR = value;
+      EECR |= _BV(EEMPE); // EEPE has to follow within 4 cycles, interrupts are off in here
+      EECR |= _BV(EEPE);
+      return; // back in here when the byte is written
+    }
+  }
+  EECR &= ~_BV(EERIE); // nothing left, stop the interrupt until the next record
+}
+
+static bool enqueue(uint16_t address, const uint8_t* bytes, uint8_t length, EepromTicket& ticket)
+{
+  bool queued = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if(job_count < EEPROM_WRITE_QUEUE_SIZE && EEPROM_WRITE_BUFFER_SIZE - data_count >= length)
+    {
+      uint8_t tail = (data_head + data_count) % EEPROM_WRITE_BUFFER_SIZE;
+      for(uint8_t i = 0; i < length; ++i)
+      {
+        data_buffer[tail] = bytes[i];
+        tail = (tail + 1) % EEPROM_WRITE_BUFFER_SIZE;
+      }
+      data_count += length;
+
+      WriteJob& job = jobs[(job_head + job_count) % EEPROM_WRITE_QUEUE_SIZE];
+      job.address = address;
+      job.length = length;
+      job.ticket = ++tickets_issued;
+      job_count++;
+      ticket = job.ticket;
+
+      EECR |= _BV(EERIE);
+      queued = true;
+    }
+  }
+  return queued;
+}
+
+EepromTicket eepromWriteAsync(uint16_t address, const void* data, uint8_t length)
+{
+  EepromTicket ticket = tickets_issued;
+  if(length == 0 || length > EEPROM_WRITE_BUFFER_SIZE) return ticket;
+
+  bool from_isr = !(SREG & _BV(SREG_I));
+  while(!enqueue(address, (const uint8_t*)data, length, ticket))
+  {
+    if(from_isr)
+    {
+      writes_dropped++;
+      return ticket;
+    }
+    // full, the interrupt makes room
+  }
+  return ticket;
+}
+
+bool eepromWriteDone(EepromTicket ticket)
+{
+  return (int8_t)(tickets_completed - ticket) >= 0;
+}
+
+bool eepromWriterIdle()
+{
+  return job_count == 0;
+}
+
+void eepromFlushWrites()
+{
+  while(!eepromWriterIdle()) { /* the interrupt is writing */ }
+}
+
+// stops the background writer after the byte that is being written, the rest of
+// the queue is left where it is. for ISR use when the EEPROM is needed right away
+void eepromHaltWrites()
+{
+  EECR &= ~_BV(EERIE);
+  while(EECR & _BV(EEPE)) { /* let the current byte finish */ }
+}
+
+void eepromResumeWrites()
+{
+  if(job_count > 0) EECR |= _BV(EERIE);
+}
+
+uint16_t eepromWritesDropped()
+{
+  uint16_t dropped;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    dropped = writes_dropped;
+  }
+  return dropped;
+}
@@ -0,0 +1,45 @@
+#ifndef EEPROM_WRITER_H
+#define EEPROM_WRITER_H
+
+#include <Arduino.h>
+
+/*
+Background EEPROM writer. A byte write takes ~3.3 ms, so instead of
+blocking in EEPROM.put() callers hand over a copy of the record and the
+EE_READY interrupt writes it one byte at a time. Bytes that already hold
+the right value are skipped, like EEPROM.put()/update().
+
+eepromWriteAsync() returns a ticket, eepromWriteDone(ticket) turns true
+once that record (and everything queued before it) is in EEPROM.
+When the queue is full it waits for room, unless it is called from an
+ISR: there the record is dropped and counted in eepromWritesDropped().
+
+Reading EEPROM while the writer is busy can return old bytes and races
+the interrupt for the address register, so loaders call
+eepromFlushWrites() before they read. eepromHaltWrites() and
+eepromResumeWrites() are for the power-fail path, which needs the EEPROM
+right now.
+*/
+
+#define EEPROM_WRITE_BUFFER_SIZE 64 // bytes of record data waiting to be written
+#define EEPROM_WRITE_QUEUE_SIZE  8  // records waiting to be written
+
+typedef uint8_t EepromTicket;
+
+EepromTicket eepromWriteAsync(uint16_t address, const void* data, uint8_t length);
+bool eepromWriteDone(EepromTicket ticket);
+bool eepromWriterIdle();
+void eepromFlushWrites();
+void eepromHaltWrites();
+void eepromResumeWrites();
+uint16_t eepromWritesDropped();
+
+// EEPROM.put() replacement for any record type
+template <typename T>
+EepromTicket eepromPutAsync(uint16_t address, const T& record)
+{
+  static_assert(sizeof(T) <= EEPROM_WRITE_BUFFER_SIZE, "record does not fit the EEPROM write buffer");
+  return eepromWriteAsync(address, &record, sizeof(T));
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include "HandshakeTiming.h"
+
+static PhaseStats phase_stats[HANDSHAKE_PHASE_COUNT];
+static uint16_t shaft_first_count = 0;
+static uint16_t incomplete_count = 0;
+
+static bool active = false;     // between SIP rise and SIP fall
+static bool shaft_first = false;
+static uint8_t marks_seen = 0;  // bit per HANDSHAKE_MARK
+static unsigned long mark_us[MARK_SIP_FALL + 1];
+
+static bool shaft_sensed = false; // shaft sense came before SIP, outside a handshake
+
+static const char* const phase_names[HANDSHAKE_PHASE_COUNT] = {
+  "SIP->SHAFT", "SHAFT->BLAST", "BLAST", "BLAST->SIP FALL", "SIP RISE->FALL"
+};
+
+static void clearStats(PhaseStats& stats)
+{
+  stats.min_us = 0xFFFFFFFF;
+  stats.max_us = 0;
+  stats.sum_us = 0;
+  stats.count = 0;
+  stats.last_us = 0;
+}
+
+static void addPhase(HANDSHAKE_PHASE phase, unsigned long us)
+{
+  PhaseStats& stats = phase_stats[phase];
+  if(us < stats.min_us) stats.min_us = us;
+  if(us > stats.max_us) stats.max_us = us;
+  stats.last_us = us;
+
+  // halve the running sum before it can overflow, the mean stays the same
+  if(stats.count == 0xFFFF || stats.sum_us > 0xFFFFFFFF - us)
+  {
+    stats.sum_us >>= 1;
+    stats.count >>= 1;
+  }
+  stats.sum_us += us;
+  stats.count++;
+}
+
+static bool seen(HANDSHAKE_MARK mark)
+{
+  return marks_seen & (1 << mark);
+}
+
+static void setMark(HANDSHAKE_MARK mark, unsigned long timestamp_us)
+{
+  mark_us[mark] = timestamp_us;
+  marks_seen |= (1 << mark);
+}
+
+// returns true when this mark completed a handshake, so the caller can report it
+bool handshakeMark(HANDSHAKE_MARK mark, unsigned long timestamp_us)
+{
+  switch(mark)
+  {
+    case MARK_SIP_RISE:
+      if(active) incomplete_count++; // lost the SIP fall in between
+      active = true;
+      marks_seen = 0;
+      shaft_first = shaft_sensed;
+      setMark(MARK_SIP_RISE, timestamp_us);
+      if(shaft_first) setMark(MARK_SHAFT_SENSE, timestamp_us);
+      return false;
+
+    case MARK_SHAFT_SENSE:
+      if(!active) shaft_sensed = true;
+      else if(!seen(MARK_SHAFT_SENSE)) setMark(MARK_SHAFT_SENSE, timestamp_us);
+      return false;
+
+    case MARK_BLAST_START:
+    case MARK_BLAST_STOP:
+      if(active && !seen(mark)) setMark(mark, timestamp_us);
+      return false;
+
+    case MARK_SHAFT_GONE:
+      if(!active) shaft_sensed = false; // the shaft that came before SIP left again
+      return false;
+
+    case MARK_SIP_FALL:
+    {
+      if(!active) return false;
+      active = false;
+      shaft_sensed = false;
+      if(!seen(MARK_SHAFT_SENSE) || !seen(MARK_BLAST_START) || !seen(MARK_BLAST_STOP))
+      {
+        incomplete_count++;
+        return false;
+      }
+      setMark(MARK_SIP_FALL, timestamp_us);
+      if(shaft_first) shaft_first_count++;
+      else addPhase(PHASE_SIP_TO_SHAFT, mark_us[MARK_SHAFT_SENSE] - mark_us[MARK_SIP_RISE]);
+      addPhase(PHASE_SHAFT_TO_BLAST, mark_us[MARK_BLAST_START] - mark_us[MARK_SHAFT_SENSE]);
+      addPhase(PHASE_BLAST, mark_us[MARK_BLAST_STOP] - mark_us[MARK_BLAST_START]);
+      addPhase(PHASE_BLAST_TO_SIP_FALL, mark_us[MARK_SIP_FALL] - mark_us[MARK_BLAST_STOP]);
+      addPhase(PHASE_TOTAL, mark_us[MARK_SIP_FALL] - mark_us[MARK_SIP_RISE]);
+      return true;
+    }
+  }
+  return false;
+}
+
+void resetHandshakeTiming()
+{
+  for(uint8_t i = 0; i < HANDSHAKE_PHASE_COUNT; ++i) clearStats(phase_stats[i]);
+  shaft_first_count = 0;
+  incomplete_count = 0;
+}
+
+const PhaseStats& handshakePhaseStats(HANDSHAKE_PHASE phase)
+{
+  return phase_stats[phase];
+}
+
+unsigned long handshakePhaseMeanUs(HANDSHAKE_PHASE phase)
+{
+  const PhaseStats& stats = phase_stats[phase];
+  if(stats.count == 0) return 0;
+  return stats.sum_us / stats.count;
+}
+
+uint16_t handshakesShaftFirst()
+{
+  return shaft_first_count;
+}
+
+uint16_t handshakesIncomplete()
+{
+  return incomplete_count;
+}
+
+const char* handshakePhaseName(HANDSHAKE_PHASE phase)
+{
+  return (phase < HANDSHAKE_PHASE_COUNT) ? phase_names[phase] : "?";
+}
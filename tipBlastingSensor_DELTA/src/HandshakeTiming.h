@@ -0,0 +1,61 @@
+#ifndef HANDSHAKE_TIMING_H
+#define HANDSHAKE_TIMING_H
+
+#include <Arduino.h>
+
+/*
+Where the time of an AUTO cycle goes, phase by phase:
+  Delta SIP rise -> shaft sense      the robot putting the shaft in
+  shaft sense    -> Start_Blasting() our input debounce and debounce_timeout
+  Start_Blasting -> Stop_Blasting()  the blast itself
+  Stop_Blasting  -> Delta SIP fall   the robot taking the shaft out
+plus SIP rise -> SIP fall for the whole handshake.
+
+loop() marks each event with its time in micros(). The SIP and shaft
+marks use the first raw edge of a debounced change, so they are not
+late by the filter. A handshake is added to the stats when SIP falls
+after a blast; a SIP that falls without a blast counts as incomplete.
+The sums are halved before they overflow, like in the loop profiler, so
+the means hold for blasts of any length.
+When the shaft was already sensed before SIP rose, the first phase is
+left out and the second one starts at the SIP rise.
+*/
+
+enum HANDSHAKE_MARK
+{
+  MARK_SIP_RISE    = 0,
+  MARK_SHAFT_SENSE = 1,
+  MARK_BLAST_START = 2,
+  MARK_BLAST_STOP  = 3,
+  MARK_SIP_FALL    = 4,
+  MARK_SHAFT_GONE  = 5  // only used to forget a shaft sensed before SIP
+};
+
+enum HANDSHAKE_PHASE
+{
+  PHASE_SIP_TO_SHAFT      = 0,
+  PHASE_SHAFT_TO_BLAST    = 1,
+  PHASE_BLAST             = 2,
+  PHASE_BLAST_TO_SIP_FALL = 3,
+  PHASE_TOTAL             = 4,
+  HANDSHAKE_PHASE_COUNT   = 5
+};
+
+struct PhaseStats
+{
+  unsigned long min_us;
+  unsigned long max_us;
+  unsigned long sum_us;
+  uint16_t count;
+  unsigned long last_us;
+};
+
+bool handshakeMark(HANDSHAKE_MARK mark, unsigned long timestamp_us);
+void resetHandshakeTiming();
+const PhaseStats& handshakePhaseStats(HANDSHAKE_PHASE phase);
+unsigned long handshakePhaseMeanUs(HANDSHAKE_PHASE phase);
+uint16_t handshakesShaftFirst();
+uint16_t handshakesIncomplete();
+const char* handshakePhaseName(HANDSHAKE_PHASE phase);
+
+#endif
@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <MsTimer2.h>
+#include <util/atomic.h>
+#include "InputFilter.h"
+#include "EdgeEventQueue.h"
+
+// inputs that read LOW when their condition is true
+#define ACTIVE_LOW_INPUTS (IN_SHAFT_PRESENT | IN_DELTA_SIP | IN_DELTA_CELL_ON | IN_DELTA_CELL_FAULTED | IN_DELTA_CELL_IN_AUTO)
+
+// samples needed to flip the debounced state (2 bit vertical counter wraps after 4)
+#define SAMPLES_TO_SETTLE 4
+
+static volatile uint8_t debounced_state = 0;
+static uint8_t previous_raw = 0;
+static uint8_t vc_bit0 = 0; // low bit of every input's vertical counter
+static uint8_t vc_bit1 = 0; // high bit of every input's vertical counter
+
+static uint8_t sample_divider[INPUT_COUNT];
+static uint8_t sample_ticks[INPUT_COUNT];
+static volatile uint16_t glitch_counts[INPUT_COUNT];
+
+// default settle times in milliseconds, indexed by INPUT_INDEX
+static const uint16_t default_settle_ms[INPUT_COUNT] = {
+  4,  // SHAFT PRESENT
+  8,  // DOOR OPEN
+  20, // MANUAL MODE
+  8,  // DELTA SIP
+  20, // DELTA CELL ON
+  20, // DELTA CELL FAULTED
+  20, // DELTA CELL IN AUTO
+};
+
+uint8_t readRawInputs()
+{
+  // one read per port so bits that share a port are sampled at the same instant
+  uint8_t pa = PINA;
+  uint8_t pc = PINC;
+  uint8_t raw = 0;
+
+  if(PINE & _BV(4)) raw |= IN_SHAFT_PRESENT;
+  if(PINB & _BV(0)) raw |= IN_DOOR_OPEN;
+  if(PINJ & _BV(1)) raw |= IN_MODE_MANUAL;
+  if(pa & _BV(2))   raw |= IN_DELTA_SIP;
+  if(pa & _BV(6))   raw |= IN_DELTA_CELL_ON;
+  if(pc & _BV(5))   raw |= IN_DELTA_CELL_FAULTED;
+  if(pc & _BV(1))   raw |= IN_DELTA_CELL_IN_AUTO;
+
+  return raw ^ ACTIVE_LOW_INPUTS;
+}
+
+// runs every INPUT_FILTER_TICK_MS from the Timer2 overflow interrupt
+static void inputFilterTick()
+{
+  uint8_t enabled = 0;
+  for(uint8_t i = 0; i < INPUT_COUNT; ++i)
+  {
+    if(++sample_ticks[i] >= sample_divider[i])
+    {
+      sample_ticks[i] = 0;
+      enabled |= (1 << i);
+    }
+  }
+
+  uint8_t raw = readRawInputs();
+  uint8_t state = debounced_state;
+  uint8_t diff = raw ^ state;
+  uint8_t differ = diff & enabled;
+  uint8_t agree = ~diff & enabled;
+
+  // an input that agrees again before its counter wrapped was a glitch
+  uint8_t glitches = agree & (vc_bit0 | vc_bit1);
+
+  // agreeing inputs restart their count, disagreeing inputs count up
+  vc_bit0 &= ~agree;
+  vc_bit1 &= ~agree;
+  uint8_t carry = vc_bit0 & differ;
+  vc_bit0 ^= differ;
+  uint8_t settled = vc_bit1 & carry; // counter wrapped 3->0
+  vc_bit1 ^= carry;
+
+  debounced_state = state ^ settled;
+
+  // the shaft sensor has its own edge interrupt, see EdgeEventQueue.cpp
+  uint8_t raw_edges = (raw ^ previous_raw) & ~IN_SHAFT_PRESENT;
+  previous_raw = raw;
+  for(uint8_t i = 0; raw_edges | settled; ++i, raw_edges >>= 1, settled >>= 1)
+  {
+    if(raw_edges & 1) pushEdgeEvent(i, bitRead(raw, i) ? EDGE_RISING : 0);
+    if(settled & 1)   pushEdgeEvent(i, EDGE_SETTLED | (bitRead(raw, i) ? EDGE_RISING : 0));
+  }
+
+  for(uint8_t i = 0; glitches; ++i, glitches >>= 1)
+  {
+    if((glitches & 1) && glitch_counts[i] != 0xFFFF) glitch_counts[i]++;
+  }
+}
+
+void initInputFilter()
+{
+  for(uint8_t i = 0; i < INPUT_COUNT; ++i)
+  {
+    setInputSettleTime((INPUT_INDEX)i, default_settle_ms[i]);
+    glitch_counts[i] = 0;
+  }
+  debounced_state = readRawInputs();
+  previous_raw = debounced_state;
+
+  MsTimer2::set(INPUT_FILTER_TICK_MS, inputFilterTick);
+  MsTimer2::start();
+}
+
+uint8_t readFilteredInputs()
+{
+  return debounced_state; // single byte, no need to block interrupts
+}
+
+void setInputSettleTime(INPUT_INDEX input, uint16_t settle_ms)
+{
+  uint16_t divider = settle_ms / (SAMPLES_TO_SETTLE * INPUT_FILTER_TICK_MS);
+  if(divider < 1) divider = 1;
+  if(divider > 255) divider = 255;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    sample_divider[input] = divider;
+    sample_ticks[input] = 0;
+  }
+}
+
+uint16_t inputSettleTime(INPUT_INDEX input)
+{
+  return (uint16_t)sample_divider[input] * SAMPLES_TO_SETTLE * INPUT_FILTER_TICK_MS;
+}
+
+uint16_t defaultInputSettleTime(INPUT_INDEX input)
+{
+  return default_settle_ms[input];
+}
+
+uint16_t inputGlitchCount(INPUT_INDEX input)
+{
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    count = glitch_counts[input];
+  }
+  return count;
+}
+
+void clearInputGlitchCounts()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    for(uint8_t i = 0; i < INPUT_COUNT; ++i) glitch_counts[i] = 0;
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef INPUT_FILTER_H
+#define INPUT_FILTER_H
+
+#include <Arduino.h>
+
+/*
+All digital inputs are sampled together from the port registers every
+INPUT_FILTER_TICK_MS by a Timer2 (MsTimer2) interrupt and debounced in
+parallel with a 2 bit vertical counter.
+
+An input only changes its debounced state after 4 consecutive samples that
+disagree with it. Each input has its own sample divider, so its settle time
+is 4 * divider * INPUT_FILTER_TICK_MS. A run of disagreeing samples that ends
+before the input settles is counted as a glitch for that input.
+
+Port/bit mapping (must match the pin numbers in main.cpp):
+SHAFT_SENSE_PIN                      2 = PE4 (active low)
+DOOR_SENSE_PIN                      53 = PB0 (5V = DOOR OPEN)
+MODE_PIN                            14 = PJ1 (5V = MANUAL MODE)
+DELTA_INPUT_CELL_SHAFT_IN_PLACE_PIN 24 = PA2 (active low)
+DELTA_INPUT_CELL_ON_PIN             28 = PA6 (active low)
+DELTA_INPUT_CELL_FAULTED_PIN        32 = PC5 (active low)
+DELTA_INPUT_CELL_IN_AUTO_PIN        36 = PC1 (active low)
+*/
+
+#define INPUT_FILTER_TICK_MS 1
+
+enum INPUT_INDEX
+{
+  INPUT_SHAFT_PRESENT      = 0,
+  INPUT_DOOR_OPEN          = 1,
+  INPUT_MODE_MANUAL        = 2,
+  INPUT_DELTA_SIP          = 3,
+  INPUT_DELTA_CELL_ON      = 4,
+  INPUT_DELTA_CELL_FAULTED = 5,
+  INPUT_DELTA_CELL_IN_AUTO = 6,
+  INPUT_COUNT              = 7
+};
+
+// logical input bits, set = condition is true. all inputs are sampled into one byte
+#define IN_SHAFT_PRESENT      (1 << INPUT_SHAFT_PRESENT)
+#define IN_DOOR_OPEN          (1 << INPUT_DOOR_OPEN)
+#define IN_MODE_MANUAL        (1 << INPUT_MODE_MANUAL)
+#define IN_DELTA_SIP          (1 << INPUT_DELTA_SIP)
+#define IN_DELTA_CELL_ON      (1 << INPUT_DELTA_CELL_ON)
+#define IN_DELTA_CELL_FAULTED (1 << INPUT_DELTA_CELL_FAULTED)
+#define IN_DELTA_CELL_IN_AUTO (1 << INPUT_DELTA_CELL_IN_AUTO)
+
+void initInputFilter(); // seeds the debounced state from the pins and starts sampling
+uint8_t readRawInputs();
+uint8_t readFilteredInputs();
+void setInputSettleTime(INPUT_INDEX input, uint16_t settle_ms);
+uint16_t inputSettleTime(INPUT_INDEX input);
+uint16_t defaultInputSettleTime(INPUT_INDEX input);
+uint16_t inputGlitchCount(INPUT_INDEX input);
+void clearInputGlitchCounts();
+
+#endif
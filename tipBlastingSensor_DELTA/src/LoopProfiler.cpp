@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "LoopProfiler.h"
+
+#define CYCLES_PER_MICROSECOND (F_CPU / 1000000UL)
+
+static volatile uint16_t timer1_overflows = 0;
+
+static SectionStats section_stats[SECTION_COUNT];
+static SectionStats iteration_stats;
+
+static volatile uint8_t open_section = SECTION_NONE;
+static unsigned long section_start = 0;
+static unsigned long iteration_start = 0;
+
+static unsigned long iteration_history[LOOP_HISTORY_COUNT]; // cycles, zeroed by the C runtime
+static uint8_t history_head = 0; // next entry to be written
+
+static const char* const section_names[SECTION_COUNT] = {
+  "INPUT READ", "DISPLAY", "BLAST CONTROL", "NEXTION LISTEN", "BUTTONS", "EEPROM"
+};
+
+ISR(TIMER1_OVF_vect)
+{
+  timer1_overflows++;
+}
+
+unsigned long profilerCycles()
+{
+  uint16_t overflows;
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    count = TCNT1;
+    overflows = timer1_overflows;
+    // an overflow that happened after interrupts were blocked has not been counted yet
+    if((TIFR1 & _BV(TOV1)) && count < 0x8000) overflows++;
+  }
+  return ((unsigned long)overflows << 16) | count;
+}
+
+static void clearStats(SectionStats& stats)
+{
+  stats.min_cycles = 0xFFFFFFFF;
+  stats.max_cycles = 0;
+  stats.sum_cycles = 0;
+  stats.count = 0;
+}
+
+static void addSample(SectionStats& stats, unsigned long cycles)
+{
+  if(cycles < stats.min_cycles) stats.min_cycles = cycles;
+  if(cycles > stats.max_cycles) stats.max_cycles = cycles;
+
+  // halve the running sum before it can overflow, the mean stays the same
+  if(stats.count == 0xFFFF || stats.sum_cycles > 0xFFFFFFFF - cycles)
+  {
+    stats.sum_cycles >>= 1;
+    stats.count >>= 1;
+  }
+  stats.sum_cycles += cycles;
+  stats.count++;
+}
+
+void resetLoopProfile()
+{
+  for(uint8_t i = 0; i < SECTION_COUNT; ++i) clearStats(section_stats[i]);
+  clearStats(iteration_stats);
+}
+
+void initLoopProfiler()
+{
+  resetLoopProfile();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10); // normal mode, no prescaler
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1);
+    TIMSK1 = _BV(TOIE1);
+  }
+}
+
+static void closeOpenSection(unsigned long now)
+{
+  if(open_section != SECTION_NONE) addSample(section_stats[open_section], now - section_start);
+  section_start = now;
+}
+
+void loopProfileBegin()
+{
+  iteration_start = profilerCycles();
+  section_start = iteration_start;
+  open_section = SECTION_NONE;
+}
+
+void loopProfileSection(LOOP_SECTION section)
+{
+  closeOpenSection(profilerCycles());
+  open_section = section;
+}
+
+void loopProfileEnd()
+{
+  unsigned long now = profilerCycles();
+  closeOpenSection(now);
+  open_section = SECTION_NONE;
+  addSample(iteration_stats, now - iteration_start);
+
+  iteration_history[history_head] = now - iteration_start;
+  history_head = (history_head + 1) % LOOP_HISTORY_COUNT;
+}
+
+LOOP_SECTION currentLoopSection()
+{
+  return (LOOP_SECTION)open_section;
+}
+
+const SectionStats& loopSectionStats(LOOP_SECTION section)
+{
+  return section_stats[section];
+}
+
+const SectionStats& loopIterationStats()
+{
+  return iteration_stats;
+}
+
+unsigned long cyclesToMicros(unsigned long cycles)
+{
+  return cycles / CYCLES_PER_MICROSECOND;
+}
+
+uint8_t worstIterationPercentOfWDT()
+{
+  unsigned long worst_us = cyclesToMicros(iteration_stats.max_cycles);
+  if(worst_us >= WDT_WINDOW_MS * 1000UL) return 100;
+  return (worst_us * 100) / (WDT_WINDOW_MS * 1000UL);
+}
+
+static uint16_t cyclesToMillis(unsigned long cycles)
+{
+  unsigned long ms = cyclesToMicros(cycles) / 1000;
+  return (ms > 0xFFFF) ? 0xFFFF : ms;
+}
+
+// age 0 = the iteration that finished last
+uint16_t recentIterationMillis(uint8_t age)
+{
+  if(age >= LOOP_HISTORY_COUNT) return 0;
+  return cyclesToMillis(iteration_history[(history_head + LOOP_HISTORY_COUNT - 1 - age) % LOOP_HISTORY_COUNT]);
+}
+
+// how long the iteration that is running now has been going, for the watchdog interrupt
+uint16_t openIterationMillis()
+{
+  return cyclesToMillis(profilerCycles() - iteration_start);
+}
+
+const char* loopSectionName(LOOP_SECTION section)
+{
+  if(section >= SECTION_COUNT) return "NONE";
+  return section_names[section];
+}
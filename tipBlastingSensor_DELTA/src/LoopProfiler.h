@@ -0,0 +1,58 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+
+/*
+Section timing for loop(). Timer1 free-runs at F_CPU with no prescaler and
+its overflow interrupt extends it to 32 bits, so every reading is in CPU
+cycles (62.5 ns at 16 MHz).
+
+loop() calls loopProfileBegin() first, loopProfileSection() whenever it
+moves on to the next section and loopProfileEnd() last. Each call closes
+the section that was open before it.
+
+The last LOOP_HISTORY_COUNT full iterations are also kept one by one, for
+the crash journal (CrashJournal.h) to see what led up to a stall.
+*/
+
+enum LOOP_SECTION
+{
+  SECTION_INPUT_READ     = 0,
+  SECTION_DISPLAY        = 1,
+  SECTION_BLAST_CONTROL  = 2,
+  SECTION_NEXTION_LISTEN = 3,
+  SECTION_BUTTONS        = 4,
+  SECTION_EEPROM         = 5,
+  SECTION_COUNT          = 6,
+  SECTION_NONE           = 0xFF
+};
+
+#define WDT_WINDOW_MS 2000 // must match the WDTO_2S timeout in setWDT()
+#define LOOP_HISTORY_COUNT 4
+
+struct SectionStats
+{
+  unsigned long min_cycles;
+  unsigned long max_cycles;
+  unsigned long sum_cycles;
+  uint16_t count;
+};
+
+void initLoopProfiler();
+unsigned long profilerCycles();
+void loopProfileBegin();
+void loopProfileSection(LOOP_SECTION section);
+void loopProfileEnd();
+void resetLoopProfile();
+
+LOOP_SECTION currentLoopSection();
+const SectionStats& loopSectionStats(LOOP_SECTION section);
+const SectionStats& loopIterationStats();
+unsigned long cyclesToMicros(unsigned long cycles);
+uint8_t worstIterationPercentOfWDT();
+uint16_t recentIterationMillis(uint8_t age);
+uint16_t openIterationMillis();
+const char* loopSectionName(LOOP_SECTION section);
+
+#endif
@@ -4,6 +4,7 @@ extern bool nexbtn_sub_1_second;
 extern bool nexbtn_add_1_second;
 extern bool nexbtn_reset_eeprom;
 extern bool nexbtn_switch_club_type;
+extern bool nexbtn_next_pulse_preset;
 
 // subtract 1 second button
 void trigger0() {
@@ -19,6 +20,12 @@ void trigger2() {
     nexbtn_reset_eeprom = true;
 }
 
-// void trigger3() {
-//     nexbtn_switch_club_type = true;
-// }
\ No newline at end of file
+// next club type / blast recipe button
+void trigger3() {
+    nexbtn_switch_club_type = true;
+}
+
+// next pulsed blast preset button
+void trigger4() {
+    nexbtn_next_pulse_preset = true;
+}
\ No newline at end of file
@@ -6,6 +6,7 @@
 void trigger0(); // Subtract 1 Second Button
 void trigger1(); // Add 1 Second Button
 void trigger2(); // clear EEPROM button
-//void trigger3(); // switch type from IRON to GRAPHITE
+void trigger3(); // next club type / blast recipe
+void trigger4(); // next pulsed blast preset
 
 #endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "PowerFailMonitor.h"
+#include "EepromLayout.h"
+#include "EepromWriter.h"
+#include "ShaftCounterLog.h"
+
+extern unsigned long total_shaft_count;
+extern unsigned long EEPROM_last_pwr_cycle_shaft_count;
+extern unsigned long lifetime_shaft_count;
+
+#define POWER_FAIL_CHECK_SEED 0xA5
+
+// 5 bytes = ~17 ms of writing, that is what the supply has to hold up for
+struct PowerFailSlot
+{
+  uint16_t counter_sequence; // newest counter slot already in EEPROM, the delta is on top of it
+  uint16_t delta;            // shafts blasted since that slot
+  uint8_t check;             // xor of the bytes above ^ POWER_FAIL_CHECK_SEED
+};
+
+static volatile uint8_t warnings = 0;
+
+static uint8_t slotCheck(const PowerFailSlot& slot)
+{
+  const uint8_t* bytes = (const uint8_t*)&slot;
+  uint8_t check = POWER_FAIL_CHECK_SEED;
+  for(uint8_t i = 0; i < offsetof(PowerFailSlot, check); ++i) check ^= bytes[i];
+  return check;
+}
+
+// ACO goes high when A0 drops below the bandgap
+ISR(ANALOG_COMP_vect)
+{
+  if(warnings < 255) warnings++;
+
+  // a counter save that is still queued will not make it, so the delta is
+  // counted from the last slot that finished writing
+  uint16_t sequence;
+  unsigned long saved_count;
+  shaftCounterCompleted(sequence, saved_count);
+  unsigned long lifetime = lifetime_shaft_count + (total_shaft_count - EEPROM_last_pwr_cycle_shaft_count);
+
+  PowerFailSlot slot;
+  slot.counter_sequence = sequence;
+  unsigned long delta = lifetime - saved_count;
+  slot.delta = (delta > 0xFFFF) ? 0xFFFF : delta;
+  slot.check = slotCheck(slot);
+
+  // written here and now, the queued writes would not make it anyway
+  eepromHaltWrites();
+  EEPROM.put(POWER_FAIL_SLOT_ADDRESS, slot);
+  eepromResumeWrites(); // only matters if the supply came back
+}
+
+void initPowerFailMonitor()
+{
+  // the comparator's - input comes from the ADC multiplexer, which needs the ADC off
+  ADCSRA &= ~_BV(ADEN);
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | _BV(ACME);
+  ADMUX = (ADMUX & 0xE0) | POWER_FAIL_SENSE_CHANNEL;
+  DIDR0 |= _BV(ADC0D); // analog only, saves the digital input buffer from a mid-rail voltage
+
+  // + input = bandgap, interrupt on ACO rising = supply falling
+  ACSR = _BV(ACBG) | _BV(ACIS1) | _BV(ACIS0);
+  delayMicroseconds(100); // bandgap settling
+  ACSR |= _BV(ACI);        // the mode change can set the flag
+  ACSR |= _BV(ACIE);
+}
+
+// returns the shafts the warning saved on top of the counter log's newest slot,
+// 0 if there was no warning since that slot or the slot is torn
+uint16_t recoverPowerFailDelta(uint16_t counter_sequence)
+{
+  PowerFailSlot slot;
+  EEPROM.get(POWER_FAIL_SLOT_ADDRESS, slot);
+  if(slot.check != slotCheck(slot)) return 0;
+  if(slot.counter_sequence != counter_sequence) return 0;
+  return slot.delta;
+}
+
+uint8_t powerFailWarnings()
+{
+  return warnings;
+}
@@ -0,0 +1,39 @@
+#ifndef POWER_FAIL_MONITOR_H
+#define POWER_FAIL_MONITOR_H
+
+#include <Arduino.h>
+
+/*
+Power-fail early warning. The analog comparator compares the internal
+1.1 V bandgap against A0 (through the ADC multiplexer), where a divider
+off the 24 V supply sits at ~2 V in normal operation. When the supply
+sags and A0 drops below 1.1 V the comparator interrupt writes the shafts
+blasted since the last shaft counter log save into a reserved 5 byte
+EEPROM slot, while the 5 V regulator still holds up the board.
+
+The slot is tagged with the newest shaft counter slot that has finished
+writing (shaftCounterCompleted()), not one that is still queued. Boot
+adds the delta only if no counter save happened after it, so a false
+alarm followed by a normal save is never counted twice.
+
+Divider: 100k from +24 V to A0, 9.1k from A0 to GND, 100 nF across the
+9.1k against relay noise. That is 2.0 V at 24 V, and the warning fires
+when the supply drops to ~13 V (1.1 V bandgap, +-10%: 12 to 14.5 V),
+well before the 5 V regulator drops out.
+
+Needs the ADC off (nothing on this board uses analogRead()).
+*/
+
+// A0 floats without the divider and the comparator would fire at random,
+// so the monitor is only started on boards that have it
+#ifndef POWER_FAIL_MONITOR_FITTED
+#define POWER_FAIL_MONITOR_FITTED 0
+#endif
+
+#define POWER_FAIL_SENSE_CHANNEL 0 // A0
+
+void initPowerFailMonitor();
+uint16_t recoverPowerFailDelta(uint16_t counter_sequence);
+uint8_t powerFailWarnings();
+
+#endif
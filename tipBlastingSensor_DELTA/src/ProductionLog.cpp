@@ -0,0 +1,237 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "ProductionLog.h"
+#include "EepromLayout.h"
+#include "EepromWriter.h"
+
+#define LOG_BLOCK_SIZE   64
+#define LOG_BLOCK_COUNT  ((PRODUCTION_LOG_END_ADDRESS - PRODUCTION_LOG_START_ADDRESS) / LOG_BLOCK_SIZE)
+#define LOG_BLOCK_HEADER 3    // sequence (2 bytes) + check
+#define LOG_BLOCK_CHECK  0xA5
+#define LOG_END_MARKER   0xFF // any byte with bit 7 set ends a block's records
+#define LOG_RECORD_MAX   12   // header + 5 + 3 + 3 varint bytes
+
+#define START_DELTA_UNIT_MS 100
+#define DURATION_UNIT_MS    10
+
+// header byte
+#define LOG_REASON_MASK      0x07
+#define LOG_MODE_AUTO        0x08
+#define LOG_CLUB_SHIFT       4
+#define LOG_CLUB_MASK        0x30
+#define LOG_FIRST_SINCE_BOOT 0x40
+
+static uint8_t head_block = LOG_BLOCK_COUNT - 1; // block the next record goes into, if it fits
+static uint16_t head_sequence = 0xFFFF;
+static uint8_t tail_offset = LOG_BLOCK_SIZE;     // where the next record goes, a full block starts a new one
+static uint16_t block_commanded = 0;              // commanded time of the block's last record, 10 ms
+
+static bool any_start_since_boot = false;
+static unsigned long previous_start_ms = 0;
+
+static int blockAddress(uint8_t block)
+{
+  return PRODUCTION_LOG_START_ADDRESS + block * LOG_BLOCK_SIZE;
+}
+
+static bool readBlockSequence(uint8_t block, uint16_t& sequence)
+{
+  int address = blockAddress(block);
+  uint8_t lo = EEPROM.read(address);
+  uint8_t hi = EEPROM.read(address + 1);
+  sequence = lo | (hi << 8);
+  return EEPROM.read(address + 2) == (uint8_t)(lo ^ hi ^ LOG_BLOCK_CHECK);
+}
+
+static uint8_t putVarint(uint8_t* out, unsigned long value)
+{
+  uint8_t length = 0;
+  while(value >= 0x80)
+  {
+    out[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = value;
+  return length;
+}
+
+// false if the varint runs past the end of the block
+static bool getVarint(int address, uint8_t& offset, unsigned long& value)
+{
+  value = 0;
+  for(uint8_t shift = 0; shift < 35; shift += 7)
+  {
+    if(offset >= LOG_BLOCK_SIZE) return false;
+    uint8_t b = EEPROM.read(address + offset++);
+    value |= (unsigned long)(b & 0x7F) << shift;
+    if(!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static unsigned long zigzag(long value)         { return (value < 0) ? ((unsigned long)(-value) << 1) - 1 : (unsigned long)value << 1; }
+static long unzigzag(unsigned long value)       { return (value & 1) ? -(long)(value >> 1) - 1 : (long)(value >> 1); }
+
+// reads the record at offset and moves offset past it, out may be NULL.
+// false on the end marker or a torn record, offset stays where it was
+static bool readRecord(int address, uint8_t& offset, uint16_t& commanded, ProductionRecord* out)
+{
+  if(offset >= LOG_BLOCK_SIZE) return false;
+  uint8_t header = EEPROM.read(address + offset);
+  if(header & 0x80) return false; // end marker
+  uint8_t record_offset = offset + 1;
+  unsigned long start_delta, commanded_delta, actual_delta;
+  if(!getVarint(address, record_offset, start_delta)) return false;
+  if(!getVarint(address, record_offset, commanded_delta)) return false;
+  if(!getVarint(address, record_offset, actual_delta)) return false;
+  if((header & LOG_REASON_MASK) > STOP_SHAFT_REMOVED) return false; // torn record
+
+  commanded += unzigzag(commanded_delta);
+  offset = record_offset;
+
+  if(out)
+  {
+    out->start_delta_ms = start_delta * START_DELTA_UNIT_MS;
+    out->commanded_ms = commanded * DURATION_UNIT_MS;
+    out->actual_ms = (commanded + unzigzag(actual_delta)) * DURATION_UNIT_MS;
+    out->reason = (STOP_REASON)(header & LOG_REASON_MASK);
+    out->mode = (header & LOG_MODE_AUTO) ? CYCLE_MODE_AUTO : CYCLE_MODE_MANUAL;
+    out->club_type = (header & LOG_CLUB_MASK) >> LOG_CLUB_SHIFT;
+    out->first_since_boot = header & LOG_FIRST_SINCE_BOOT;
+  }
+  return true;
+}
+
+// leaves offset on the end marker of the block
+static void skipBlock(uint8_t block, uint8_t& offset, uint16_t& commanded)
+{
+  offset = LOG_BLOCK_HEADER;
+  commanded = 0;
+  while(readRecord(blockAddress(block), offset, commanded, NULL)) { }
+}
+
+// finds the newest block and the end of its records, like the shaft counter log finds its head
+void loadProductionLog()
+{
+  eepromFlushWrites();
+
+  uint16_t current_sequence;
+  uint16_t next_sequence;
+  bool current_valid = readBlockSequence(0, current_sequence);
+
+  for(uint8_t i = 0; i < LOG_BLOCK_COUNT; ++i)
+  {
+    uint8_t n = (i + 1) % LOG_BLOCK_COUNT;
+    bool next_valid = readBlockSequence(n, next_sequence);
+    if(current_valid && (!next_valid || next_sequence != (uint16_t)(current_sequence + 1)))
+    {
+      head_block = i;
+      head_sequence = current_sequence;
+      skipBlock(head_block, tail_offset, block_commanded);
+      return;
+    }
+    current_sequence = next_sequence;
+    current_valid = next_valid;
+  }
+  // empty log, the first record starts block 0
+}
+
+static void startBlock()
+{
+  head_block = (head_block + 1) % LOG_BLOCK_COUNT;
+  head_sequence++;
+  // the end marker goes in first, as a job of its own. the block only validates once
+  // its header is written, and by then the previous rotation's records are cut off
+  uint8_t marker = LOG_END_MARKER;
+  eepromWriteAsync(blockAddress(head_block) + LOG_BLOCK_HEADER, &marker, 1);
+  uint8_t header[LOG_BLOCK_HEADER] = { (uint8_t)head_sequence, (uint8_t)(head_sequence >> 8), 0 };
+  header[2] = header[0] ^ header[1] ^ LOG_BLOCK_CHECK;
+  eepromWriteAsync(blockAddress(head_block), header, sizeof(header));
+  tail_offset = LOG_BLOCK_HEADER;
+  block_commanded = 0;
+}
+
+static uint8_t encodeRecord(uint8_t* out, uint8_t header, unsigned long start_delta, uint16_t commanded, uint16_t actual)
+{
+  uint8_t length = 0;
+  out[length++] = header;
+  length += putVarint(out + length, start_delta);
+  length += putVarint(out + length, zigzag((long)commanded - block_commanded));
+  length += putVarint(out + length, zigzag((long)actual - commanded));
+  return length;
+}
+
+// called from the blast cycle when a blast stops, the record is written in the background
+void logProductionCycle(unsigned long start_ms, unsigned long commanded_ms, unsigned long actual_ms, STOP_REASON reason, CYCLE_MODE mode, uint8_t club_type)
+{
+  uint8_t header = (reason & LOG_REASON_MASK) | ((club_type << LOG_CLUB_SHIFT) & LOG_CLUB_MASK);
+  if(mode == CYCLE_MODE_AUTO) header |= LOG_MODE_AUTO;
+  if(!any_start_since_boot) header |= LOG_FIRST_SINCE_BOOT;
+
+  unsigned long start_delta = (any_start_since_boot ? start_ms - previous_start_ms : start_ms) / START_DELTA_UNIT_MS;
+  any_start_since_boot = true;
+  previous_start_ms = start_ms;
+
+  uint16_t commanded = min(commanded_ms / DURATION_UNIT_MS, 0xFFFFUL);
+  uint16_t actual = min(actual_ms / DURATION_UNIT_MS, 0xFFFFUL);
+
+  uint8_t record[LOG_RECORD_MAX + 1];
+  uint8_t length = encodeRecord(record, header, start_delta, commanded, actual);
+  if(tail_offset + length + 1 > LOG_BLOCK_SIZE)
+  {
+    startBlock();
+    length = encodeRecord(record, header, start_delta, commanded, actual);
+  }
+  record[length] = LOG_END_MARKER; // overwritten by the next record
+
+  // the rest of the record and the new end marker first, behind the current end marker.
+  // the header byte replaces that marker last, as a job of its own, so the record
+  // only shows up once all of it is in EEPROM
+  int address = blockAddress(head_block) + tail_offset;
+  eepromWriteAsync(address + 1, record + 1, length);
+  eepromWriteAsync(address, record, 1);
+  tail_offset += length;
+  block_commanded = commanded;
+}
+
+// puts the cursor on the oldest record. false if nothing was logged yet
+bool openProductionLog(ProductionLogCursor& cursor)
+{
+  eepromFlushWrites();
+  if(head_sequence == 0xFFFF && tail_offset == LOG_BLOCK_SIZE) return false;
+
+  // walk back to the oldest block that still continues the sequence
+  uint8_t age = 0;
+  for(uint8_t i = 1; i < LOG_BLOCK_COUNT; ++i)
+  {
+    uint8_t previous = (head_block + LOG_BLOCK_COUNT - i) % LOG_BLOCK_COUNT;
+    uint16_t sequence;
+    if(!readBlockSequence(previous, sequence) || sequence != (uint16_t)(head_sequence - i)) break;
+    age = i;
+  }
+
+  cursor.block = (head_block + LOG_BLOCK_COUNT - age) % LOG_BLOCK_COUNT;
+  cursor.sequence = head_sequence - age;
+  cursor.offset = LOG_BLOCK_HEADER;
+  cursor.commanded = 0;
+  return true;
+}
+
+// one record per call, oldest first. records logged while the cursor is open are read too
+LOG_READ nextProductionRecord(ProductionLogCursor& cursor, ProductionRecord& record)
+{
+  if(!eepromWriterIdle()) return LOG_READ_BUSY; // reading would race the writer, try again later
+
+  while(true)
+  {
+    uint16_t sequence;
+    if(!readBlockSequence(cursor.block, sequence) || sequence != cursor.sequence) return LOG_READ_OVERWRITTEN;
+    if(readRecord(blockAddress(cursor.block), cursor.offset, cursor.commanded, &record)) return LOG_READ_RECORD;
+    if(cursor.block == head_block) return LOG_READ_END;
+
+    cursor.block = (cursor.block + 1) % LOG_BLOCK_COUNT;
+    cursor.sequence++;
+    cursor.offset = LOG_BLOCK_HEADER;
+    cursor.commanded = 0;
+  }
+}
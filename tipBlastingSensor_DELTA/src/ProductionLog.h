@@ -0,0 +1,65 @@
+#ifndef PRODUCTION_LOG_H
+#define PRODUCTION_LOG_H
+
+#include <Arduino.h>
+#include "BlastCycle.h"
+
+/*
+One record per blast cycle in a circular EEPROM region, for the 'l' dump
+on the debug port. Every stop is logged, aborts as well as completed
+blasts.
+
+The region is cut into 64 byte blocks. A block starts with its sequence
+number, the records follow and a 0xFF byte ends them. A record is
+  header  - STOP_REASON, CYCLE_MODE, CLUB_TYPE, "first since boot"
+  varint  - start time minus the previous start, in 100 ms
+  varint  - commanded time minus the previous record's, zigzag, in 10 ms
+  varint  - actual time minus commanded, zigzag, in 10 ms
+which is 5 bytes for a typical cycle (the commanded time rarely changes,
+a completed blast ends within 10 ms of it), so the 2 KB region holds the
+last ~350 cycles, not thousands: the 4 KB EEPROM also holds the shaft
+counter log (1 KB) and the config, and a longer history would need
+external storage (FRAM or an SD card). The commanded delta restarts
+from 0 in every block, so a block can be read on its own once the one
+before it is overwritten.
+
+The first cycle after a boot has no previous start, its start delta is
+counted from the boot.
+
+A record's header byte goes in over the end marker only after the rest
+of the record and the new end marker are written, so a reset in the
+middle leaves the block ending where it did before.
+
+The log is read with a cursor, one record per call, so the dump can go
+out a line per loop() iteration. nextProductionRecord() does not read
+while the background writer is busy, and notices when the block it is
+in gets overwritten.
+*/
+
+struct ProductionRecord
+{
+  unsigned long start_delta_ms;
+  uint16_t commanded_ms;
+  uint16_t actual_ms;
+  STOP_REASON reason;
+  CYCLE_MODE mode;
+  uint8_t club_type;    // CLUB_TYPE
+  bool first_since_boot;
+};
+
+struct ProductionLogCursor
+{
+  uint8_t block;
+  uint16_t sequence;  // the block's sequence number, checked before every read
+  uint8_t offset;     // of the next record in the block
+  uint16_t commanded; // commanded time of the previous record, 10 ms
+};
+
+enum LOG_READ { LOG_READ_RECORD = 0, LOG_READ_BUSY = 1, LOG_READ_END = 2, LOG_READ_OVERWRITTEN = 3 };
+
+void loadProductionLog();
+void logProductionCycle(unsigned long start_ms, unsigned long commanded_ms, unsigned long actual_ms, STOP_REASON reason, CYCLE_MODE mode, uint8_t club_type);
+bool openProductionLog(ProductionLogCursor& cursor);
+LOG_READ nextProductionRecord(ProductionLogCursor& cursor, ProductionRecord& record);
+
+#endif
@@ -0,0 +1,99 @@
+#include <Arduino.h>
+#include "PulsedBlast.h"
+
+#define BLAST_RELAY_PIN 8 // RELAY_CTRL_PIN in main.cpp, OC4C = PH5
+#define PULSE_TIMER_TICKS_PER_SECOND (F_CPU / 1024UL)
+
+struct PulseTiming
+{
+  uint16_t period_ms; // 0 = continuous
+  uint16_t on_ms;
+};
+
+static const PulseTiming pulse_timings[PULSE_PRESET_COUNT] = {
+  {    0,   0 }, // PULSE_CONTINUOUS
+  {  200, 100 }, // PULSE_5HZ_50
+  {  500, 250 }, // PULSE_2HZ_50
+  {  500, 350 }, // PULSE_2HZ_70
+  { 1000, 800 }, // PULSE_1HZ_80
+};
+
+static const char* const pulse_names[PULSE_PRESET_COUNT] = {
+  "CONTINUOUS", "5HZ 50%", "2HZ 50%", "2HZ 70%", "1HZ 80%"
+};
+
+static PULSE_PRESET active_preset = PULSE_CONTINUOUS;
+
+static uint16_t msToTicks(uint16_t ms)
+{
+  return (uint16_t)(((unsigned long)ms * PULSE_TIMER_TICKS_PER_SECOND) / 1000UL);
+}
+
+static void stopPulseTimer()
+{
+  TCCR4B = 0;
+  TCCR4A = 0; // disconnects OC4C, the pin goes back to its PORT value
+}
+
+void initBlastRelay()
+{
+  stopPulseTimer();
+  pinMode(BLAST_RELAY_PIN, OUTPUT);
+  digitalWrite(BLAST_RELAY_PIN, LOW);
+}
+
+void blastRelayOn()
+{
+  const PulseTiming& timing = pulse_timings[active_preset];
+  if(timing.period_ms == 0)
+  {
+    digitalWrite(BLAST_RELAY_PIN, HIGH);
+    return;
+  }
+
+  // the PORT value is what the pin falls back to when the timer lets go of it
+  digitalWrite(BLAST_RELAY_PIN, LOW);
+  stopPulseTimer();
+  ICR4 = msToTicks(timing.period_ms) - 1;
+  OCR4C = msToTicks(timing.on_ms) - 1;
+  TCNT4 = ICR4; // next tick wraps to BOTTOM, which sets OC4C and starts the first on time
+  TCCR4A = _BV(COM4C1) | _BV(WGM41);                          // non-inverting on OC4C
+  TCCR4B = _BV(WGM43) | _BV(WGM42) | _BV(CS42) | _BV(CS40);   // fast PWM TOP = ICR4, clk/1024
+}
+
+void blastRelayOff()
+{
+  stopPulseTimer();
+  digitalWrite(BLAST_RELAY_PIN, LOW);
+}
+
+// true for the whole of a pulsed blast, the off times included
+bool blastRelayIsOn()
+{
+  return TCCR4B != 0 || digitalRead(BLAST_RELAY_PIN) == HIGH;
+}
+
+// takes effect on the next blastRelayOn(), a running blast keeps its pattern
+void setPulsePreset(PULSE_PRESET preset)
+{
+  if(preset < PULSE_PRESET_COUNT) active_preset = preset;
+}
+
+PULSE_PRESET pulsePreset()
+{
+  return active_preset;
+}
+
+// share of a blast the relay is on, 100 for continuous
+uint8_t pulseDutyPercent(PULSE_PRESET preset)
+{
+  if(preset >= PULSE_PRESET_COUNT) return 100;
+  const PulseTiming& timing = pulse_timings[preset];
+  if(timing.period_ms == 0) return 100;
+  return ((unsigned long)timing.on_ms * 100) / timing.period_ms;
+}
+
+const char* pulsePresetName(PULSE_PRESET preset)
+{
+  return (preset < PULSE_PRESET_COUNT) ? pulse_names[preset] : "?";
+}
@@ -0,0 +1,39 @@
+#ifndef PULSED_BLAST_H
+#define PULSED_BLAST_H
+
+#include <Arduino.h>
+
+/*
+Blast relay output with an optional pulsed mode. The relay is on
+RELAY_CTRL_PIN 8, which is OC4C, so a pulsed blast is generated by
+Timer4 in hardware (fast PWM, TOP = ICR4, clk/1024 = 64 us per tick)
+and costs loop() nothing. The continuous preset drives the pin like
+before.
+
+The presets keep the on and off times well above the solenoid valve's
+response time (~20-30 ms), shorter pulses would never open the valve
+fully. Timer4 is taken over from analogWrite(), nothing else on this
+board uses pins 6/7/8.
+*/
+
+enum PULSE_PRESET
+{
+  PULSE_CONTINUOUS = 0,
+  PULSE_5HZ_50     = 1, // 100 ms on / 100 ms off
+  PULSE_2HZ_50     = 2, // 250 ms on / 250 ms off
+  PULSE_2HZ_70     = 3, // 350 ms on / 150 ms off
+  PULSE_1HZ_80     = 4, // 800 ms on / 200 ms off
+  PULSE_PRESET_COUNT = 5
+};
+
+void initBlastRelay();
+void blastRelayOn();
+void blastRelayOff();
+bool blastRelayIsOn();
+
+void setPulsePreset(PULSE_PRESET preset);
+PULSE_PRESET pulsePreset();
+uint8_t pulseDutyPercent(PULSE_PRESET preset);
+const char* pulsePresetName(PULSE_PRESET preset);
+
+#endif
@@ -0,0 +1,162 @@
+#include <Arduino.h>
+#include <util/atomic.h>
+#include "ShaftCapture.h"
+
+#define CAPTURE_TICKS_PER_US (F_CPU / 8 / 1000000UL) // clk/8 = 2 ticks per us
+#define MAX_GAP_MS           (30 * 60000UL)          // the 32 bit tick count wraps after ~35 min
+
+static volatile uint16_t timer5_overflows = 0;
+
+// all three are written in the capture interrupt, read with interrupts blocked
+static CaptureStats present_width;
+static CaptureStats gap_width;
+static CaptureStats response_time;
+
+static volatile unsigned long last_arrival_ticks = 0;
+static volatile unsigned long last_departure_ticks = 0;
+static volatile unsigned long last_departure_ms = 0;
+static volatile bool shaft_sensed = false;
+static volatile bool have_departure = false;
+static volatile bool response_pending = false; // the shaft that is in has not started a blast yet
+
+static void clearStats(CaptureStats& stats)
+{
+  stats.min_us = 0xFFFFFFFF;
+  stats.max_us = 0;
+  stats.sum_us = 0;
+  stats.count = 0;
+}
+
+static void addSample(CaptureStats& stats, unsigned long ticks)
+{
+  unsigned long us = ticks / CAPTURE_TICKS_PER_US;
+  if(us < stats.min_us) stats.min_us = us;
+  if(us > stats.max_us) stats.max_us = us;
+
+  // halve the running sum before it can overflow, the mean stays the same
+  if(stats.count == 0xFFFF || stats.sum_us > 0xFFFFFFFF - us)
+  {
+    stats.sum_us >>= 1;
+    stats.count >>= 1;
+  }
+  stats.sum_us += us;
+  stats.count++;
+}
+
+// extends a 16 bit timer reading with the overflow count. interrupts must be off
+static unsigned long extendTicks(uint16_t count)
+{
+  uint16_t overflows = timer5_overflows;
+  // an overflow that has not been counted yet belongs to readings from after it
+  if((TIFR5 & _BV(TOV5)) && count < 0x8000) overflows++;
+  return ((unsigned long)overflows << 16) | count;
+}
+
+ISR(TIMER5_OVF_vect)
+{
+  timer5_overflows++;
+}
+
+ISR(TIMER5_CAPT_vect)
+{
+  unsigned long ticks = extendTicks(ICR5);
+  bool falling = !(TCCR5B & _BV(ICES5)); // the edge this capture was armed for
+
+  // arm for the edge that can come next from the level the pin is at now, not by
+  // flipping ICES5: a pulse shorter than the interrupt latency would leave a flipped
+  // edge select waiting for the wrong edge from then on. changing ICES5 can set ICF5 on its own
+  if(PINL & _BV(1)) TCCR5B &= ~_BV(ICES5); // no shaft, wait for it to arrive
+  else TCCR5B |= _BV(ICES5);               // shaft in, wait for it to leave
+  TIFR5 = _BV(ICF5);
+
+  if(falling) // LOW = SHAFT PRESENT
+  {
+    if(have_departure && millis() - last_departure_ms < MAX_GAP_MS) addSample(gap_width, ticks - last_departure_ticks);
+    last_arrival_ticks = ticks;
+    shaft_sensed = true;
+    response_pending = true;
+  }
+  else if(shaft_sensed)
+  {
+    addSample(present_width, ticks - last_arrival_ticks);
+    last_departure_ticks = ticks;
+    last_departure_ms = millis();
+    have_departure = true;
+    shaft_sensed = false;
+    response_pending = false;
+  }
+}
+
+void resetShaftCapture()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    clearStats(present_width);
+    clearStats(gap_width);
+    clearStats(response_time);
+  }
+}
+
+void initShaftCapture()
+{
+  pinMode(SHAFT_CAPTURE_PIN, INPUT);
+  resetShaftCapture();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    TCCR5A = 0;
+    TCCR5B = _BV(ICNC5) | _BV(CS51); // normal mode, noise canceler, falling edge first, clk/8
+    // a shaft that is already in is waiting for its rising edge
+    if(!(PINL & _BV(1)))
+    {
+      TCCR5B |= _BV(ICES5);
+      last_arrival_ticks = 0;
+      shaft_sensed = false; // its width is unknown
+    }
+    TCNT5 = 0;
+    TIFR5 = _BV(ICF5) | _BV(TOV5);
+    TIMSK5 = _BV(ICIE5) | _BV(TOIE5);
+  }
+}
+
+// called right after the blast relay is switched on for a blast that a shaft arrival started
+void shaftCaptureBlastStarted()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if(response_pending)
+    {
+      addSample(response_time, extendTicks(TCNT5) - last_arrival_ticks);
+      response_pending = false;
+    }
+  }
+}
+
+static CaptureStats copyStats(const CaptureStats& stats)
+{
+  CaptureStats copy;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    copy = stats;
+  }
+  return copy;
+}
+
+CaptureStats shaftPresentWidth()
+{
+  return copyStats(present_width);
+}
+
+CaptureStats shaftGapWidth()
+{
+  return copyStats(gap_width);
+}
+
+CaptureStats shaftResponseTime()
+{
+  return copyStats(response_time);
+}
+
+unsigned long captureMeanUs(const CaptureStats& stats)
+{
+  return stats.count ? stats.sum_us / stats.count : 0;
+}
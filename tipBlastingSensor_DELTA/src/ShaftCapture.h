@@ -0,0 +1,57 @@
+#ifndef SHAFT_CAPTURE_H
+#define SHAFT_CAPTURE_H
+
+#include <Arduino.h>
+
+/*
+Hardware timestamps of the shaft sensor. The KI-3015 / 4N27 output that
+goes to SHAFT_SENSE_PIN 2 is also wired to pin 48, which is ICP5, so
+Timer5 latches every edge into ICR5 by itself: 0.5 us resolution
+(clk/8), plus the 4 clock noise canceler, with no interrupt latency in
+the timestamp. The capture interrupt switches the edge select after every
+edge, so both edges are caught, and the overflow interrupt extends the
+16 bit timer to 32 bits.
+
+Kept since boot, in microseconds:
+ - how long the shaft was sensed (falling to rising, the input is active low)
+ - the gaps between shafts, up to 30 minutes (the 32 bit count wraps after ~35)
+ - the response: shaft edge to blast relay on, for blasts that a shaft
+   arrival started (MANUAL mode; in AUTO the Delta handshake phases
+   cover it)
+
+The capture interrupt arms the next edge from the pin level it finds,
+so a pulse too short for it to see both edges is skipped instead of
+putting the edge select out of step.
+
+Pin 48 has to be jumpered to the sensor output on pin 2. Without the
+jumper pin 48 floats and the capture would log noise, so
+initShaftCapture() only runs with SHAFT_CAPTURE_FITTED set to 1.
+
+Timer5 is taken over from analogWrite(), pins 44/45/46 are only used as
+digital I/O on this board.
+*/
+
+#ifndef SHAFT_CAPTURE_FITTED
+#define SHAFT_CAPTURE_FITTED 0
+#endif
+
+#define SHAFT_CAPTURE_PIN 48 // ICP5 = PL1, in parallel with SHAFT_SENSE_PIN
+
+struct CaptureStats
+{
+  unsigned long min_us;
+  unsigned long max_us;
+  unsigned long sum_us;
+  uint16_t count;
+};
+
+void initShaftCapture();
+void shaftCaptureBlastStarted();
+void resetShaftCapture();
+
+CaptureStats shaftPresentWidth();
+CaptureStats shaftGapWidth();
+CaptureStats shaftResponseTime();
+unsigned long captureMeanUs(const CaptureStats& stats);
+
+#endif
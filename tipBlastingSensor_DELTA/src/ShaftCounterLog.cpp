@@ -0,0 +1,135 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include "ShaftCounterLog.h"
+#include "EepromLayout.h"
+#include "EepromWriter.h"
+
+struct CounterSlot
+{
+  uint32_t count;
+  uint16_t sequence;
+  uint16_t crc; // over count and sequence
+};
+
+#define COUNTER_SLOT_COUNT ((SHAFT_COUNTER_LOG_END_ADDRESS - SHAFT_COUNTER_LOG_START_ADDRESS) / sizeof(CounterSlot))
+
+static uint8_t head_slot = COUNTER_SLOT_COUNT - 1; // newest slot, the next save goes into the one after it
+static uint16_t head_sequence = 0xFFFF;            // so the first save ever is sequence 0
+
+// newest slot known to be in EEPROM, and the queued one that follows it.
+// read from ISR(ANALOG_COMP_vect)
+static uint16_t completed_sequence = 0xFFFF;
+static unsigned long completed_count = 0;
+static bool pending = false;
+static EepromTicket pending_ticket = 0;
+static uint16_t pending_sequence = 0;
+static unsigned long pending_count = 0;
+
+static void updateCompleted()
+{
+  if(pending && eepromWriteDone(pending_ticket))
+  {
+    completed_sequence = pending_sequence;
+    completed_count = pending_count;
+    pending = false;
+  }
+}
+
+static uint16_t slotCrc(const CounterSlot& slot)
+{
+  const uint8_t* bytes = (const uint8_t*)&slot;
+  uint16_t crc = 0xFFFF;
+  for(uint8_t i = 0; i < offsetof(CounterSlot, crc); ++i) crc = _crc16_update(crc, bytes[i]);
+  return crc;
+}
+
+static int slotAddress(uint8_t slot)
+{
+  return SHAFT_COUNTER_LOG_START_ADDRESS + slot * sizeof(CounterSlot);
+}
+
+static bool readSlot(uint8_t slot, CounterSlot& out)
+{
+  EEPROM.get(slotAddress(slot), out);
+  return out.crc == slotCrc(out);
+}
+
+// returns the all-time shaft count. an empty ring (new board, or the first
+// boot after this log was added) starts from legacy_count
+unsigned long loadShaftCounter(unsigned long legacy_count)
+{
+  eepromFlushWrites();
+
+  CounterSlot current;
+  CounterSlot next;
+  bool current_valid = readSlot(0, current);
+
+  for(uint8_t i = 0; i < COUNTER_SLOT_COUNT; ++i)
+  {
+    uint8_t n = (i + 1) % COUNTER_SLOT_COUNT;
+    bool next_valid = readSlot(n, next);
+    if(current_valid && (!next_valid || next.sequence != (uint16_t)(current.sequence + 1)))
+    {
+      head_slot = i;
+      head_sequence = current.sequence;
+      completed_sequence = current.sequence;
+      completed_count = current.count;
+      pending = false;
+      return current.count;
+    }
+    current = next;
+    current_valid = next_valid;
+  }
+
+  // no valid slot at all
+  head_slot = COUNTER_SLOT_COUNT - 1;
+  head_sequence = 0xFFFF;
+  appendShaftCounter(legacy_count);
+  eepromFlushWrites(); // so the seeded slot counts as completed right away
+  updateCompleted();
+  return legacy_count;
+}
+
+// also called from ISR(WDT_vect). the slot is written in the background (EepromWriter.h)
+void appendShaftCounter(unsigned long count)
+{
+  CounterSlot slot;
+  slot.count = count;
+  slot.sequence = head_sequence + 1;
+  slot.crc = slotCrc(slot);
+
+  uint8_t target = (head_slot + 1) % COUNTER_SLOT_COUNT;
+  uint16_t dropped = eepromWritesDropped();
+  EepromTicket ticket = eepromPutAsync(slotAddress(target), slot); // not atomic, it may wait for room
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    updateCompleted(); // before the newer save takes the pending place
+    if(eepromWritesDropped() == dropped) // a dropped slot never completes
+    {
+      pending = true;
+      pending_ticket = ticket;
+      pending_sequence = slot.sequence;
+      pending_count = count;
+    }
+  }
+  head_slot = target;
+  head_sequence = slot.sequence;
+}
+
+uint16_t shaftCounterSequence()
+{
+  return head_sequence;
+}
+
+// the newest slot that is in EEPROM, not just queued. 0xFFFF before the first one
+void shaftCounterCompleted(uint16_t& sequence, unsigned long& count)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    updateCompleted();
+    sequence = completed_sequence;
+    count = completed_count;
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef SHAFT_COUNTER_LOG_H
+#define SHAFT_COUNTER_LOG_H
+
+#include <Arduino.h>
+
+/*
+Wear-leveled store for the all-time shaft count. Every save appends a
+slot (count, sequence number, CRC) to a ring of slots instead of
+rewriting the same four bytes, so every EEPROM cell in the ring is
+written once per 128 saves.
+
+At boot the ring is scanned once: the newest slot is the valid one
+whose successor is not valid or does not continue its sequence number.
+A slot torn by a reset in the middle of its write fails its CRC, and
+the slot before it is used.
+
+A save is only queued (EepromWriter.h). shaftCounterCompleted() returns
+the newest slot whose write has finished, which is what the power-fail
+warning builds on.
+*/
+
+unsigned long loadShaftCounter(unsigned long legacy_count);
+void appendShaftCounter(unsigned long count);
+uint16_t shaftCounterSequence();
+void shaftCounterCompleted(uint16_t& sequence, unsigned long& count);
+
+#endif
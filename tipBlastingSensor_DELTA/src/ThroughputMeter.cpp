@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include "ThroughputMeter.h"
+
+#define MS_PER_MINUTE 60000UL
+
+static uint8_t minute_buckets[THROUGHPUT_WINDOW_MINUTES];
+static uint8_t minute_head = 0;      // bucket of the current minute
+static uint8_t minutes_covered = 1;  // buckets that hold real data, up to the window
+static uint16_t window_sum = 0;      // sum of all minute buckets
+
+static uint16_t hour_slots[THROUGHPUT_HOUR_SLOTS]; // full hours, newest at hour_head - 1
+static uint8_t hour_head = 0;
+static uint8_t hours_filled = 0;
+static uint16_t this_hour = 0;
+static uint8_t minutes_this_hour = 0;
+
+static unsigned long minute_start = 0;
+
+void countThroughputShaft()
+{
+  if(minute_buckets[minute_head] < 0xFF)
+  {
+    minute_buckets[minute_head]++;
+    window_sum++;
+  }
+  if(this_hour < 0xFFFF) this_hour++;
+}
+
+static void closeHour()
+{
+  hour_slots[hour_head] = this_hour;
+  hour_head = (hour_head + 1) % THROUGHPUT_HOUR_SLOTS;
+  if(hours_filled < THROUGHPUT_HOUR_SLOTS) hours_filled++;
+  this_hour = 0;
+  minutes_this_hour = 0;
+}
+
+// returns true when a minute went by, so the caller knows to redraw
+bool serviceThroughputMeter()
+{
+  if(millis() - minute_start < MS_PER_MINUTE) return false;
+
+  // catches up one minute per call, loop() never stalls long enough for more to pile up
+  minute_start += MS_PER_MINUTE;
+  minute_head = (minute_head + 1) % THROUGHPUT_WINDOW_MINUTES;
+  window_sum -= minute_buckets[minute_head];
+  minute_buckets[minute_head] = 0;
+  if(minutes_covered < THROUGHPUT_WINDOW_MINUTES) minutes_covered++;
+
+  if(++minutes_this_hour == 60) closeHour();
+  return true;
+}
+
+// the current minute is only partly over, so the window covers the full minutes
+// before it plus the time since minute_start. at least a minute, so the first
+// shafts after a boot don't read as a huge rate
+uint16_t shaftsPerHour()
+{
+  unsigned long covered_ms = (unsigned long)(minutes_covered - 1) * MS_PER_MINUTE + (millis() - minute_start);
+  if(covered_ms < MS_PER_MINUTE) covered_ms = MS_PER_MINUTE;
+  unsigned long rate = ((unsigned long)window_sum * 36000UL) / (covered_ms / 100); // 36000 = 1 h in 100 ms
+  return (rate > 0xFFFF) ? 0xFFFF : rate;
+}
+
+// hours_ago 0 = the last full hour
+uint16_t hourlyShaftCount(uint8_t hours_ago)
+{
+  if(hours_ago >= hours_filled) return 0;
+  return hour_slots[(hour_head + THROUGHPUT_HOUR_SLOTS - 1 - hours_ago) % THROUGHPUT_HOUR_SLOTS];
+}
+
+uint8_t fullHoursCounted()
+{
+  return hours_filled;
+}
+
+uint16_t shaftsThisHour()
+{
+  return this_hour;
+}
@@ -0,0 +1,30 @@
+#ifndef THROUGHPUT_METER_H
+#define THROUGHPUT_METER_H
+
+#include <Arduino.h>
+
+/*
+Shafts per hour over a sliding window, plus the counts of the last 24
+hours. Shafts are counted into one minute buckets; the window is the
+last THROUGHPUT_WINDOW_MINUTES of them and its sum is kept up to date as
+buckets come and go, so reading the rate costs nothing. Every full
+hour's count goes into a ring of 24.
+
+serviceThroughputMeter() is called every loop(), it only does work when
+a minute has passed. The rate is scaled by the time the buckets actually
+cover, so the current, partly over minute doesn't drag it down, and
+before the first window has filled it is scaled from the minutes there
+are.
+*/
+
+#define THROUGHPUT_WINDOW_MINUTES 15
+#define THROUGHPUT_HOUR_SLOTS     24
+
+void countThroughputShaft();
+bool serviceThroughputMeter();
+uint16_t shaftsPerHour();
+uint16_t hourlyShaftCount(uint8_t hours_ago);
+uint8_t fullHoursCounted();
+uint16_t shaftsThisHour();
+
+#endif
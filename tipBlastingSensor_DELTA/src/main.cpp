@@ -1,6 +1,8 @@
 /*
 EEPROM CONTENTS DEFINITION:
-Address 0 = total shafts blasted over all time (unsigned long 32 bit (4 byte) variable)
+see EepromLayout.h. the total shafts blasted over all time lives in the
+shaft counter log (ShaftCounterLog.h), the settings in the A/B config
+records (ConfigStore.h)
 */
 
 #include <Arduino.h>
@@ -8,21 +10,39 @@ Address 0 = total shafts blasted over all time (unsigned long 32 bit (4 byte) va
 #include <EasyNextionLibrary.h>
 #include <stdlib.h> // for string operations
 #include <avr/wdt.h>
+#include <util/atomic.h>
 #include <EEPROM.h>
+#include "BlastCycle.h"
+#include "InputFilter.h"
+#include "EdgeEventQueue.h"
+#include "LoopProfiler.h"
+#include "PulsedBlast.h"
+#include "BlastRecipe.h"
+#include "EepromLayout.h"
+#include "ShaftCounterLog.h"
+#include "EepromWriter.h"
+#include "ConfigStore.h"
+#include "PowerFailMonitor.h"
+#include "CrashJournal.h"
+#include "ProductionLog.h"
+#include "BlastStats.h"
+#include "ThroughputMeter.h"
+#include "HandshakeTiming.h"
+#include "AdaptiveDebounce.h"
+#include "ShaftCapture.h"
 
 bool enableSerialDebug = true;
 
-#define SHAFT_SENSE_PIN 2
+#define SHAFT_SENSE_PIN 2 // also wired to pin 48 (ICP5) for the hardware timestamps, see ShaftCapture.h
 #define MODE_PIN 14
 #define RELAY_CTRL_PIN 8
 #define DOOR_SENSE_PIN 53
 
 // convenience defines
-#define RELAY_ON         digitalWrite(RELAY_CTRL_PIN, HIGH)
-#define RELAY_OFF        digitalWrite(RELAY_CTRL_PIN, LOW)
+#define RELAY_ON         blastRelayOn()  // continuous or pulsed, see PulsedBlast.h
+#define RELAY_OFF        blastRelayOff()
 #define SHAFT_SENSOR     digitalRead(SHAFT_SENSE_PIN)
 #define DOOR_SENSOR      digitalRead(DOOR_SENSE_PIN) // 5V=DOOR OPEN / GND=DOOR CLOSED
-#define MODE_CHOICE      digitalRead(MODE_PIN);
 
 // delta signals
 
@@ -51,6 +71,8 @@ TO Delta:
 #define DELTA_INPUT_CELL_ON_PIN             28
 #define DELTA_INPUT_CELL_FAULTED_PIN        32
 #define DELTA_INPUT_CELL_IN_AUTO_PIN        36 
+#define DELTA_INPUT_RECIPE_BIT0_PIN         40 // recipe code, 0 = keep the recipe picked on the nextion
+#define DELTA_INPUT_RECIPE_BIT1_PIN         44 // 1 = GRAPHITE, 2 = IRON, 3 = GENERIC
 
 #define DELTA_MACHINE_NOT_SAFE     digitalWrite(DELTA_OUTPUT_MACHINE_SAFE_PIN, HIGH)
 #define DELTA_MACHINE_IS_SAFE      digitalWrite(DELTA_OUTPUT_MACHINE_SAFE_PIN, LOW)
@@ -63,6 +85,8 @@ TO Delta:
 #define DELTA_CELL_ON              !digitalRead(DELTA_INPUT_CELL_ON_PIN)
 #define DELTA_CELL_FAULTED         !digitalRead(DELTA_INPUT_CELL_FAULTED_PIN)
 #define DELTA_CELL_IN_AUTO         !digitalRead(DELTA_INPUT_CELL_IN_AUTO_PIN)
+#define DELTA_RECIPE_CODE          ((!digitalRead(DELTA_INPUT_RECIPE_BIT1_PIN) << 1) | !digitalRead(DELTA_INPUT_RECIPE_BIT0_PIN))
+#define DELTA_RECIPE_RESAMPLE_US   500 // gap between the two reads of the recipe code
 
 #define NEX_CLOSED         2
 #define NEX_NO             3
@@ -74,16 +98,18 @@ TO Delta:
 #define NEX_AUTOMATIC_MODE 9
 #define NEX_MANUAL_MODE    10
 
-#define EEPROM_CONTENTS_START_ADDRESS 0 // 4 bytes wide
+#define NEX_DIAGNOSTICS_PAGE 1 // hidden page, text fields pf0..pf6 hold the loop profile, pf7 the last crash, pf8 the shaft capture
+#define NEX_STATS_PAGE       2 // text fields st0..st3 hold the blast statistics, hs0..hs4 the handshake phases
 
-enum CLUB_TYPE { GRAPHITE, IRON, GENERIC };
 
 SoftwareSerial swSerial(11, 12); // nextion display will be connected to 11(RX-BLUE) and 12(TX-YELLOW)
 EasyNex myNex(swSerial);
 
-unsigned long debounce_timeout    = 250;  // milliseconds
+unsigned long debounce_timeout    = 250;  // milliseconds, minimum gap between blast starts, set by the active recipe. AdaptiveDebounce.h may use less. the inputs themselves are debounced in InputFilter.cpp
+unsigned long debounce_timeout_min = 50;
+unsigned long debounce_timeout_max = 5000;
 unsigned long last_debounce_time  = 0;    // milliseconds
-unsigned long totalBlastTime         = 7000; // milliseconds
+unsigned long totalBlastTime         = 7000; // milliseconds, set by the active recipe
 unsigned long totalBlastTime_min = 1000;
 unsigned long totalBlastTime_max = 30000;
 unsigned long previousBlastStartTime = 0;
@@ -93,29 +119,20 @@ unsigned long heartbeatPulseLength = 150;  // HB
 
 // FOR EEPROM OPERATIONS:
 unsigned long EEPROM_last_pwr_cycle_shaft_count = 0;
-unsigned long EEPROM_save_period = 3600000; // 1 hour
-unsigned long EEPROM_last_save_time = 0;
+unsigned long params_dump_period = 3600000; // 1 hour, serial debug dump only
+unsigned long params_last_dump_time = 0;
 
-struct EEPROM_CONTENTS 
-{
-  // set default values initially
-  unsigned long EEPROM_total_shaft_count = 0;
-  CLUB_TYPE club_type = CLUB_TYPE::GENERIC; // club type no longer tracked, making this generic for now
-  unsigned long saved_on_time = 4000;
-};
+// the shaft counter log is appended every SHAFT_COUNTER_SAVE_EVERY shafts, from Stop_Blasting().
+// 128 slots * 100k cycles per cell = 12.8M saves, so every 10 shafts the ring lasts 128M shafts,
+// over 60 years at 2 shafts a minute around the clock. a power loss loses at most 9 shafts
+// unless the power fail monitor is fitted, the watchdog ISR saves the count before its reset
+#define SHAFT_COUNTER_SAVE_EVERY 10
 
-EEPROM_CONTENTS ec;
+unsigned long lifetime_shaft_count = 0; // all time, as of the last save to the shaft counter log
 
-boolean prev_shaft_sensor_value = true; // PULL-UP, AKA no shaft present = HIGH
-boolean prev_door_sensor_value = true; // DOOR-OPEN, starting with door open as default for safety
-boolean prev_sip_delta_value = false; 
+uint8_t prev_inputs = IN_DOOR_OPEN | IN_DELTA_CELL_FAULTED; // no shaft, door open and Delta faulted as default for safety
 boolean machineCurrentlyBlasting = false;
-boolean prev_delta_cell_on_value = false;
-boolean prev_delta_cell_faulted_value = true;
-boolean prev_delta_cell_in_auto_value = false;
-
-boolean currentShaftBlastHasBeenHandled_Delta = false;
-boolean currentShaftBlastHasBeenHandled_Ping = false;
+volatile bool wdt_fired = false; // set by ISR(WDT_vect), loop() stops feeding the watchdog so the reset happens
 
 volatile boolean heartbeatLogicalState = false; // HB
 
@@ -123,10 +140,38 @@ volatile boolean heartbeatLogicalState = false; // HB
 bool nexbtn_sub_1_second = false;
 bool nexbtn_add_1_second = false;
 bool nexbtn_reset_eeprom = false;
-//bool nexbtn_switch_club_type = false;
+bool nexbtn_next_pulse_preset = false;
+bool nexbtn_switch_club_type = false;
 
 bool ModeStatus_ManualIfTrueAutoIfFalse = true; // false = AUTO MODE, true = MANUAL MODE
-bool mode_switch_previous_value = false;
+
+// nextion status pictures driven by a single input bit.
+// rows are written whenever their input bit changes in one of their modes
+struct StatusIndicator
+{
+  uint8_t input_bit;
+  uint8_t modes; // bitmask of (1 << CYCLE_MODE)
+  const char* component;
+  uint8_t pic_when_set;
+  uint8_t pic_when_clear;
+};
+
+#define IND_MANUAL (1 << CYCLE_MODE_MANUAL)
+#define IND_AUTO   (1 << CYCLE_MODE_AUTO)
+
+const StatusIndicator statusIndicators[] = {
+  { IN_DOOR_OPEN,          IND_MANUAL | IND_AUTO, "p2.pic",  NEX_OPEN,     NEX_CLOSED },
+  { IN_DOOR_OPEN,          IND_AUTO,              "p5.pic",  NEX_NOT_SAFE, NEX_SAFE },
+  { IN_SHAFT_PRESENT,      IND_MANUAL | IND_AUTO, "p3.pic",  NEX_YES,      NEX_NO_SHAFT },
+  { IN_SHAFT_PRESENT,      IND_AUTO,              "p6.pic",  NEX_YES,      NEX_NO_SHAFT },
+  { IN_DELTA_SIP,          IND_AUTO,              "p8.pic",  NEX_YES,      NEX_NO_SHAFT },
+  { IN_DELTA_CELL_ON,      IND_AUTO,              "p9.pic",  NEX_YES,      NEX_NO },
+  { IN_DELTA_CELL_FAULTED, IND_AUTO,              "p10.pic", NEX_YES,      NEX_NO },
+  { IN_DELTA_CELL_IN_AUTO, IND_AUTO,              "p11.pic", NEX_YES,      NEX_NO },
+};
+
+// names for the "[INFO] ... TRANSITION" debug prints, indexed by INPUT_INDEX
+const char* const inputNames[INPUT_COUNT] = { "SHAFT PRESENT", "DOOR OPEN", "MANUAL MODE", "DELTA SIP", "DELTA CELL ON", "DELTA CELL FAULTED", "DELTA CELL IN AUTO" };
 
 void delaySafeMillis(unsigned long timeToWaitMilli) 
 {
@@ -138,11 +183,22 @@ void delaySafeMillis(unsigned long timeToWaitMilli)
 ISR(WDT_vect) 
 {
   wdt_disable();
-  // quickly save our data to the EEPROM before resetting:
-  ec.EEPROM_total_shaft_count += (total_shaft_count - EEPROM_last_pwr_cycle_shaft_count);
-  ec.saved_on_time = totalBlastTime;
-  EEPROM.put(EEPROM_CONTENTS_START_ADDRESS, ec);
-  WDTCSR = bit (WDE); // this should reset the Arduino
+  wdt_fired = true;
+  // what loop() was stuck in, before anything below changes it
+  uint8_t flags = 0;
+  if(machineCurrentlyBlasting) flags |= CRASH_FLAG_BLASTING;
+  if(blastRelayIsOn()) flags |= CRASH_FLAG_RELAY_ON;
+  if(ModeStatus_ManualIfTrueAutoIfFalse) flags |= CRASH_FLAG_MANUAL_MODE;
+  if(!eepromWriterIdle()) flags |= CRASH_FLAG_EEPROM_BUSY;
+
+  // queue our data for the EEPROM before resetting, the EE_READY interrupt writes it after we return:
+  // (the settings are committed whenever they change, only the count is behind)
+  lifetime_shaft_count += (total_shaft_count - EEPROM_last_pwr_cycle_shaft_count);
+  appendShaftCounter(lifetime_shaft_count);
+  recordCrash(flags, prev_inputs, currentBlastCycleState());
+  // reset the Arduino. a full write buffer (EEPROM_WRITE_BUFFER_SIZE = 64 bytes at ~3.4 ms) takes ~220 ms,
+  // so 250 ms lets the writer finish whatever was queued before us as well as the 8 + 18 bytes here
+  wdt_enable(WDTO_250MS);
 }
 
 void setWDT(byte sWDT) 
@@ -166,109 +222,161 @@ void outputHeartbeatSignal() // old HB
   }
 }
 
-void updateManualOrAutoModeStatusTextOnNextionScreen()
+CYCLE_MODE currentCycleMode()
 {
-  if(ModeStatus_ManualIfTrueAutoIfFalse) myNex.writeNum("p12.pic", NEX_MANUAL_MODE);
-  else myNex.writeNum("p12.pic", NEX_AUTOMATIC_MODE);
-}
-
-void resetBeforeEnteringManualMode()
-{
-  if(enableSerialDebug) Serial.println("[INFO] Switching machine to MANUAL MODE");
-  machineCurrentlyBlasting = false;
-  RELAY_OFF;
-
-  updateManualOrAutoModeStatusTextOnNextionScreen();
+  return ModeStatus_ManualIfTrueAutoIfFalse ? CYCLE_MODE_MANUAL : CYCLE_MODE_AUTO;
 }
 
-void resetBeforeEnteringAutoMode()
+bool deltaMachineAvailable(uint8_t inputs)
 {
-  if(enableSerialDebug) Serial.println("[INFO] Switching machine to AUTOMATIC MODE");
-  machineCurrentlyBlasting = false;
-  RELAY_OFF;
-
-  updateManualOrAutoModeStatusTextOnNextionScreen();
+  return (inputs & IN_DELTA_CELL_ON) && (inputs & IN_DELTA_CELL_IN_AUTO) && !(inputs & IN_DELTA_CELL_FAULTED);
 }
 
-void initOnStartup()
+// write every indicator whose input bit is in "changed" and that belongs to the current mode
+void updateStatusIndicators(uint8_t inputs, uint8_t changed)
 {
-  // read the current value of all signals and 
-  prev_shaft_sensor_value  = SHAFT_SENSOR;    // LOW = SHAFT PRESENT // HIGH = NO SHAFT PRESENT
-  prev_door_sensor_value   = DOOR_SENSOR;     // LOW = DOOR CLOSED // HIGH = DOOR OPEN
-  // external signals from delta machine
-  prev_sip_delta_value     = DELTA_CELL_SHAFT_IN_PLACE;
-  prev_delta_cell_on_value = DELTA_CELL_ON;
-  prev_delta_cell_faulted_value = DELTA_CELL_FAULTED;
-  prev_delta_cell_in_auto_value = DELTA_CELL_IN_AUTO;
+  const uint8_t mode_bit = 1 << currentCycleMode();
 
-  if(!prev_shaft_sensor_value) 
-  {
-    DELTA_YES_SHAFT;
-    myNex.writeNum("p6.pic", NEX_YES);
-    myNex.writeNum("p3.pic", NEX_YES);      // DETECT SHAFT PRESENT
-  }
-  else if (prev_shaft_sensor_value) 
+  for(uint8_t i = 0; i < sizeof(statusIndicators) / sizeof(statusIndicators[0]); ++i)
   {
-    DELTA_NO_SHAFT;
-    myNex.writeNum("p6.pic", NEX_NO_SHAFT);
-    myNex.writeNum("p3.pic", NEX_NO_SHAFT); // DETECT SHAFT ABSENT
+    const StatusIndicator& ind = statusIndicators[i];
+    if((changed & ind.input_bit) && (ind.modes & mode_bit))
+    {
+      myNex.writeNum(ind.component, (inputs & ind.input_bit) ? ind.pic_when_set : ind.pic_when_clear);
+    }
   }
 
-  if(!prev_door_sensor_value) 
-  {
-    DELTA_MACHINE_IS_SAFE; // to delta
-    myNex.writeNum("p2.pic", NEX_CLOSED);   // DETECT DOOR OPEN->CLOSE TRANSITION
-    myNex.writeNum("p5.pic", NEX_SAFE);
-  } 
-  else if (prev_door_sensor_value) 
+  // the Delta outputs are only driven while the Delta is in charge of the cell
+  if(mode_bit & IND_AUTO)
   {
-    DELTA_MACHINE_NOT_SAFE; // to delta
-    myNex.writeNum("p2.pic", NEX_OPEN);     // DETECT DOOR CLOSE->OPEN TRANSITION
-    myNex.writeNum("p5.pic", NEX_NOT_SAFE);
+    if(changed & IN_DOOR_OPEN)
+    {
+      if(inputs & IN_DOOR_OPEN) DELTA_MACHINE_NOT_SAFE; // to delta
+      else DELTA_MACHINE_IS_SAFE; // to delta
+    }
+    if(changed & IN_SHAFT_PRESENT)
+    {
+      if(inputs & IN_SHAFT_PRESENT) DELTA_YES_SHAFT;
+      else DELTA_NO_SHAFT;
+    }
   }
 
-  if(prev_sip_delta_value) 
-  {
-    myNex.writeNum("p8.pic", NEX_YES);
-    currentShaftBlastHasBeenHandled_Delta = true; // VET THIS!!
-  }
-  else if(!prev_sip_delta_value) 
+  if(enableSerialDebug)
   {
-    myNex.writeNum("p8.pic", NEX_NO_SHAFT);
-    currentShaftBlastHasBeenHandled_Delta = true; // VET THIS!!
+    for(uint8_t b = 0; b < sizeof(inputNames) / sizeof(inputNames[0]); ++b)
+    {
+      if(!(changed & (1 << b)) || (changed == 0xFF)) continue; // no prints for a full refresh
+      Serial.print("[INFO] ");
+      Serial.print(inputNames[b]);
+      Serial.println((inputs & (1 << b)) ? " NO->YES TRANSITION" : " YES->NO TRANSITION");
+    }
   }
+}
 
-  if(prev_delta_cell_on_value) 
-  {
-    myNex.writeNum("p9.pic", NEX_YES);
-  }
-  else if(!prev_delta_cell_on_value) 
-  {
-    myNex.writeNum("p9.pic", NEX_NO);
-  }
+// first raw edge of each input since its last debounced change, so the
+// handshake marks are not late by the filter. a glitch that goes back to
+// the debounced state drops the pending edge again
+unsigned long first_raw_edge_us[INPUT_COUNT];
+bool raw_edge_pending[INPUT_COUNT];
+bool settled_state[INPUT_COUNT];
 
-  if(prev_delta_cell_faulted_value) 
+void reportHandshake()
+{
+  if(!enableSerialDebug) return;
+  Serial.print("[INFO] HANDSHAKE (ms):");
+  for(uint8_t i = 0; i < HANDSHAKE_PHASE_COUNT; ++i)
   {
-    myNex.writeNum("p10.pic", NEX_YES);
+    const PhaseStats& stats = handshakePhaseStats((HANDSHAKE_PHASE)i);
+    Serial.print(" ");
+    Serial.print(handshakePhaseName((HANDSHAKE_PHASE)i));
+    Serial.print("=");
+    Serial.print(stats.last_us / 1000);
   }
-  else if(!prev_delta_cell_faulted_value) 
+  Serial.println();
+}
+
+// drain the edge event queue. at most EDGE_QUEUE_SIZE events can be waiting
+void processEdgeEvents()
+{
+  EdgeEvent ev;
+  while(popEdgeEvent(ev))
   {
-    myNex.writeNum("p10.pic", NEX_NO);
+    bool rising = ev.flags & EDGE_RISING;
+    if(!(ev.flags & EDGE_SETTLED))
+    {
+      adaptiveDebounceEdge((INPUT_INDEX)ev.input, ev.timestamp_us);
+      if(rising == settled_state[ev.input]) raw_edge_pending[ev.input] = false;
+      else if(!raw_edge_pending[ev.input])
+      {
+        first_raw_edge_us[ev.input] = ev.timestamp_us;
+        raw_edge_pending[ev.input] = true;
+      }
+      continue;
+    }
+
+    unsigned long timestamp_us = raw_edge_pending[ev.input] ? first_raw_edge_us[ev.input] : ev.timestamp_us;
+    raw_edge_pending[ev.input] = false;
+    settled_state[ev.input] = rising;
+
+    if(ev.input == INPUT_DELTA_SIP)
+    {
+      if(handshakeMark(rising ? MARK_SIP_RISE : MARK_SIP_FALL, timestamp_us)) reportHandshake();
+    }
+    else if(ev.input == INPUT_SHAFT_PRESENT)
+    {
+      handshakeMark(rising ? MARK_SHAFT_SENSE : MARK_SHAFT_GONE, timestamp_us);
+    }
   }
+}
 
-  if(prev_delta_cell_in_auto_value) 
+void updateManualOrAutoModeStatusTextOnNextionScreen()
+{
+  if(ModeStatus_ManualIfTrueAutoIfFalse) myNex.writeNum("p12.pic", NEX_MANUAL_MODE);
+  else myNex.writeNum("p12.pic", NEX_AUTOMATIC_MODE);
+}
+
+void resetBeforeEnteringMode(uint8_t inputs)
+{
+  ModeStatus_ManualIfTrueAutoIfFalse = inputs & IN_MODE_MANUAL;
+
+  if(enableSerialDebug)
   {
-    myNex.writeNum("p11.pic", NEX_YES);
+    if(ModeStatus_ManualIfTrueAutoIfFalse) Serial.println("[INFO] Switching machine to MANUAL MODE");
+    else Serial.println("[INFO] Switching machine to AUTOMATIC MODE");
   }
-  else if(!prev_delta_cell_in_auto_value) 
+
+  machineCurrentlyBlasting = false;
+  RELAY_OFF;
+  resetBlastCycle(currentCycleMode());
+
+  updateManualOrAutoModeStatusTextOnNextionScreen();
+  // indicators that belong only to the new mode may be stale, redraw everything
+  updateStatusIndicators(inputs, 0xFF);
+}
+
+void initOnStartup()
+{
+  // read the current value of all signals and reflect them to the nextion screen and the delta
+  prev_inputs = readFilteredInputs();
+  for(uint8_t i = 0; i < INPUT_COUNT; ++i) settled_state[i] = prev_inputs & (1 << i); // for the raw edges in processEdgeEvents()
+  ModeStatus_ManualIfTrueAutoIfFalse = prev_inputs & IN_MODE_MANUAL; // check initial state of the switch
+  updateManualOrAutoModeStatusTextOnNextionScreen();
+
+  // this runs in either mode, so write the delta outputs and every picture regardless of mode
+  if(prev_inputs & IN_SHAFT_PRESENT) DELTA_YES_SHAFT;
+  else DELTA_NO_SHAFT;
+  if(prev_inputs & IN_DOOR_OPEN) DELTA_MACHINE_NOT_SAFE; // to delta
+  else DELTA_MACHINE_IS_SAFE; // to delta
+
+  for(uint8_t i = 0; i < sizeof(statusIndicators) / sizeof(statusIndicators[0]); ++i)
   {
-    myNex.writeNum("p11.pic", NEX_NO);
+    const StatusIndicator& ind = statusIndicators[i];
+    myNex.writeNum(ind.component, (prev_inputs & ind.input_bit) ? ind.pic_when_set : ind.pic_when_clear);
   }
 
-  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-  // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  // a shaft that is already in place at power-up is treated as handled,
+  // the blast cycle only arms on the next Delta SIP NO->YES edge
+  resetBlastCycle(currentCycleMode());
 }
 
 void outputHeartbeatSignal_WithTimer() // new HB
@@ -277,69 +385,159 @@ void outputHeartbeatSignal_WithTimer() // new HB
   digitalWrite(DELTA_OUTPUT_HEARTBEAT_PIN, heartbeatLogicalState);
 }
 
+// the hour that is running, then the full hours newest first
+String hourlyCountsText()
+{
+  String text = String(shaftsThisHour());
+  for(uint8_t i = 0; i < fullHoursCounted(); ++i) text += " " + String(hourlyShaftCount(i));
+  return text;
+}
+
+// next to the session (t0) and lifetime (t2) counts. the hourly counts (t6) are the
+// longest string on the page, they only go out once a minute from loop()
+void updateThroughputText()
+{
+  myNex.writeStr("t5.txt", String(shaftsPerHour()) + "/h");
+}
+
+void updateHourlyCountsText()
+{
+  myNex.writeStr("t6.txt", hourlyCountsText());
+}
+
 void updateNextionScreen() 
 {
   myNex.writeStr("t0.txt", String(total_shaft_count));
   unsigned long seconds = totalBlastTime / 1000;
   myNex.writeStr("t1.txt", String(seconds));
-  myNex.writeStr("t2.txt", String(ec.EEPROM_total_shaft_count));
+  myNex.writeStr("t2.txt", String(lifetime_shaft_count));
+  myNex.writeStr("t3.txt", pulsePresetName(pulsePreset()));
+  myNex.writeStr("t4.txt", clubTypeName(activeClubType()));
+  updateThroughputText();
 }
 
-void updateEEPROMContents() 
+void saveShaftCounter()
 {
-  ec.EEPROM_total_shaft_count += (total_shaft_count - EEPROM_last_pwr_cycle_shaft_count);
-  ec.saved_on_time = totalBlastTime;
-  // save this total new value back into EEPROM
-  EEPROM.put(EEPROM_CONTENTS_START_ADDRESS, ec);
-  // reset our tracking variable so we can get an accurate shaft delta next EEPROM update
-  EEPROM_last_pwr_cycle_shaft_count = total_shaft_count;
+  // the watchdog and power-fail interrupts add the unsaved delta on top of lifetime_shaft_count,
+  // they must never see the new total together with the old EEPROM_last_pwr_cycle_shaft_count
+  unsigned long count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    lifetime_shaft_count += (total_shaft_count - EEPROM_last_pwr_cycle_shaft_count);
+    // reset our tracking variable so we can get an accurate shaft delta next EEPROM update
+    EEPROM_last_pwr_cycle_shaft_count = total_shaft_count;
+    count = lifetime_shaft_count;
+  }
+  // save this total new value back into EEPROM. outside the block, it may wait for room in the queue
+  appendShaftCounter(count);
+}
 
+// the settings are committed whenever they change and the count every
+// SHAFT_COUNTER_SAVE_EVERY shafts, this only reports them
+void printSavedParams()
+{
   if(enableSerialDebug)
   {
     Serial.println(" -- SAVED PARAMS: -- ");
-    Serial.print("ec.club_type:");
-    Serial.println(ec.club_type);
-    Serial.print("ec.EEPROM_total_shaft_count:");
-    Serial.println(ec.EEPROM_total_shaft_count);
-    Serial.print("ec.saved_on_time:");
-    Serial.println(ec.saved_on_time);
+    Serial.print("club type:");
+    Serial.println(clubTypeName(activeClubType()));
+    Serial.print("lifetime shaft count:");
+    Serial.println(lifetime_shaft_count);
+    Serial.print("blast time:");
+    Serial.println(totalBlastTime);
+    Serial.println(" -- INPUT GLITCHES REJECTED: -- ");
+    for(uint8_t i = 0; i < INPUT_COUNT; ++i)
+    {
+      Serial.print(inputNames[i]);
+      Serial.print(":");
+      Serial.println(inputGlitchCount((INPUT_INDEX)i));
+    }
+    Serial.print("EDGE EVENTS DROPPED:");
+    Serial.println(edgeEventsDropped());
+    Serial.print("EEPROM WRITES DROPPED:");
+    Serial.println(eepromWritesDropped());
+    Serial.print("POWER FAIL WARNINGS:");
+    Serial.println(powerFailWarnings());
   }
 
   updateNextionScreen();
 }
 
+// one line per crash: sequence, section, stalled time and the iterations before it
+String crashRecordText(const CrashRecord& record)
+{
+  String text = "#" + String(record.sequence) + " " + loopSectionName((LOOP_SECTION)record.section) + " " + String(record.stalled_ms) + "ms <";
+  for(uint8_t i = 0; i < LOOP_HISTORY_COUNT; ++i) text += " " + String(record.loop_ms[i]);
+  return text;
+}
+
+void printCrashJournal()
+{
+  Serial.println(" -- WATCHDOG CRASH JOURNAL (newest first): -- ");
+  CrashRecord record;
+  for(uint8_t age = 0; crashRecord(age, record); ++age)
+  {
+    Serial.println(crashRecordText(record));
+    Serial.print("  SP:0x");
+    Serial.print(record.stack_pointer, HEX);
+    Serial.print(" FLAGS:");
+    Serial.print(record.flags, BIN);
+    Serial.print(" INPUTS:");
+    Serial.print(record.inputs, BIN);
+    Serial.print(" CYCLE STATE:");
+    Serial.println(record.cycle_state);
+  }
+  if(crashRecordCount() == 0) Serial.println("none");
+}
+
 void loadEEPROMContents() 
 {
-  EEPROM.get(EEPROM_CONTENTS_START_ADDRESS, ec);
-  
-  // check for uninitialized EEPROM (will be all 1's)
-  if(ec.saved_on_time > 30000) {
-    ec.saved_on_time = 7000;
-    ec.club_type = CLUB_TYPE::GRAPHITE;
-    ec.EEPROM_total_shaft_count = 0;
-    updateEEPROMContents(); // write the defaults to EEPROM
+  // a new board or a bad pair of copies comes up with the migrated/default settings
+  bool config_valid = loadConfig();
+
+  // the first boot with the shaft counter log carries the old count over
+  lifetime_shaft_count = loadShaftCounter(legacyShaftCount());
+  // shafts the power-fail warning saved after the newest counter slot
+  uint16_t power_fail_delta = recoverPowerFailDelta(shaftCounterSequence());
+  if(power_fail_delta > 0)
+  {
+    lifetime_shaft_count += power_fail_delta;
+    appendShaftCounter(lifetime_shaft_count); // moves the sequence on, so the delta is not added twice
   }
 
-  totalBlastTime = ec.saved_on_time;
+  loadRecipes();
+  loadCrashJournal();
+  loadProductionLog();
 
   if(enableSerialDebug)
   {
     Serial.println(" -- PARAMS LOADED UPON STARTUP: -- ");
-    Serial.print("ec.club_type:");
-    Serial.println(ec.club_type);
-    Serial.print("ec.EEPROM_total_shaft_count:");
-    Serial.println(ec.EEPROM_total_shaft_count);
-    Serial.print("ec.saved_on_time:");
-    Serial.println(ec.saved_on_time);
+    if(!config_valid) Serial.println("no valid config record, settings migrated/defaulted");
+    Serial.print("config copy:");
+    Serial.print(configCopyName());
+    Serial.print(" sequence:");
+    Serial.println(configRecord().sequence);
+    Serial.print("club type:");
+    Serial.println(clubTypeName(activeClubType()));
+    Serial.print("lifetime shaft count:");
+    Serial.println(lifetime_shaft_count);
+    Serial.print("shaft counter log sequence:");
+    Serial.println(shaftCounterSequence());
+    Serial.print("recovered at power fail:");
+    Serial.println(power_fail_delta);
+    Serial.print("blast time:");
+    Serial.println(totalBlastTime);
+    printCrashJournal();
   }
 }
 
 void clearEEPROMContents() 
 {
-  // set first 4 bytes to 0 (ADDR0,1,2,3)
-  ec.EEPROM_total_shaft_count = 0x0;
-  ec.saved_on_time = totalBlastTime;
-  EEPROM.put(EEPROM_CONTENTS_START_ADDRESS, ec); // reset total shaft count EEPROM to 0
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    lifetime_shaft_count = 0x0; // 4 bytes, the interrupts above read it
+  }
+  appendShaftCounter(0); // reset total shaft count EEPROM to 0
   updateNextionScreen();
 }
 
@@ -355,7 +553,7 @@ void setup()
                              // safety pin. INPUT_PULLUP so that if door sensor is missing,
                              // the system will safely default to a "DOOR OPEN" state
   pinMode(MODE_PIN, INPUT_PULLUP); // 5V(HIGH) = MANUAL MODE, GND(LOW) = AUTO MODE
-  pinMode(RELAY_CTRL_PIN, OUTPUT); // relay on/off pin
+  initBlastRelay(); // relay on/off pin, also stops Timer4 for pulsed blasting
 
   pinMode(DELTA_OUTPUT_MACHINE_SAFE_PIN, OUTPUT);
   pinMode(DELTA_OUTPUT_HEARTBEAT_PIN, OUTPUT);
@@ -366,6 +564,8 @@ void setup()
   pinMode(DELTA_INPUT_CELL_ON_PIN, INPUT); 
   pinMode(DELTA_INPUT_CELL_FAULTED_PIN, INPUT); 
   pinMode(DELTA_INPUT_CELL_IN_AUTO_PIN, INPUT); 
+  pinMode(DELTA_INPUT_RECIPE_BIT0_PIN, INPUT);
+  pinMode(DELTA_INPUT_RECIPE_BIT1_PIN, INPUT);
 
   delaySafeMillis(5);
 
@@ -378,23 +578,22 @@ void setup()
   // hard code to TRUE (which means setting the pin false because it will go through opto-isolation)
   digitalWrite(DELTA_OUTPUT_HEARTBEAT_PIN, false);  // HB 
 
-  ModeStatus_ManualIfTrueAutoIfFalse = MODE_CHOICE; // check initial state of the switch
-  mode_switch_previous_value = ModeStatus_ManualIfTrueAutoIfFalse;
-
-  if(!ModeStatus_ManualIfTrueAutoIfFalse)
-  {
-    resetBeforeEnteringAutoMode();
-  }
-  else if(ModeStatus_ManualIfTrueAutoIfFalse)
-  {
-    resetBeforeEnteringManualMode();
-  }
-
   setWDT(0b01000000); // 00001000 = just reset if WDT not handled within timeframe
                       // 01001000 = set to trigger interrupt then reset
                       // 01000000 = just interrupt
 
   loadEEPROMContents();
+#if POWER_FAIL_MONITOR_FITTED
+  initPowerFailMonitor(); // after the load, a warning tags its slot with the loaded counter sequence
+#endif
+
+  initLoopProfiler();
+  initInputFilter(); // start debouncing every input in the background
+  resetHandshakeTiming();
+  initEdgeEventCapture();
+#if SHAFT_CAPTURE_FITTED
+  initShaftCapture(); // hardware timestamps of the shaft sensor on ICP5
+#endif
 
   initOnStartup(); // poll all inputs and reflect them to nextion screen
 
@@ -408,16 +607,21 @@ void Start_Blasting()
   myNex.writeNum("p4.pic", NEX_YES); // "BLASTING = YES"
   myNex.writeNum("p7.pic", NEX_YES);
   RELAY_ON;
+  if(currentCycleMode() == CYCLE_MODE_MANUAL) shaftCaptureBlastStarted(); // the shaft arrival started this blast
+  handshakeMark(MARK_BLAST_START, micros());
 }
 
 void Stop_Blasting() 
 {
   machineCurrentlyBlasting = false;
   RELAY_OFF;
+  handshakeMark(MARK_BLAST_STOP, micros());
   DELTA_NOT_BLASTING; // signal to delta
   myNex.writeNum("p4.pic", NEX_NO); // "BLASTING = NO"
   myNex.writeNum("p7.pic", NEX_NO);
   total_shaft_count += 1;
+  countThroughputShaft();
+  if(total_shaft_count - EEPROM_last_pwr_cycle_shaft_count >= SHAFT_COUNTER_SAVE_EVERY) saveShaftCounter();
   updateNextionScreen(); // update the shaft count
 }
 
@@ -425,355 +629,444 @@ void handleMillisRolloverCondition()
 {
   // Shaft debounce rollover:
   if(millis() < last_debounce_time) last_debounce_time = 0;
-  // EEPROM rollover:
-  if((unsigned long)millis() < EEPROM_last_save_time) EEPROM_last_save_time = 0;
+  // debug dump rollover:
+  if((unsigned long)millis() < params_last_dump_time) params_last_dump_time = 0;
 }
 
-bool checkDeltaMachineIsWorkingAndAvailable()
+// the nextion edits the recipe of the club type that is selected
+void storeBlastTimeInRecipe()
 {
-  bool out = false;
-
-  bool current_delta_cell_on_value = DELTA_CELL_ON;
-  bool current_delta_cell_faulted_value = DELTA_CELL_FAULTED;
-  bool current_delta_cell_in_auto_value = DELTA_CELL_IN_AUTO;
-
-  out = current_delta_cell_on_value and current_delta_cell_in_auto_value and !current_delta_cell_faulted_value;
-
-  return out;
+  BlastRecipe recipe = activeRecipe();
+  recipe.blast_time_ms = totalBlastTime;
+  updateActiveRecipe(recipe);
 }
 
-int eeprom_update_counter = 0; // DEBUG
-void automationModeLoop()
+void printActiveRecipe()
 {
-  // my local machine signals
-  bool current_shaft_sensor_value  = SHAFT_SENSOR;    // LOW = SHAFT PRESENT // HIGH = NO SHAFT PRESENT
-  bool current_door_sensor_value   = DOOR_SENSOR;     // LOW = DOOR CLOSED // HIGH = DOOR OPEN
-  // external signals from delta machine
-  bool current_delta_sip_value     = DELTA_CELL_SHAFT_IN_PLACE;
-  bool current_delta_cell_on_value = DELTA_CELL_ON;
-  bool current_delta_cell_faulted_value = DELTA_CELL_FAULTED;
-  bool current_delta_cell_in_auto_value = DELTA_CELL_IN_AUTO;
-
-  bool DELTA_MACHINE_AVAILABLE = current_delta_cell_on_value and current_delta_cell_in_auto_value and !current_delta_cell_faulted_value;
+  if(!enableSerialDebug) return;
+  Serial.print("[INFO] RECIPE:");
+  Serial.print(clubTypeName(activeClubType()));
+  Serial.print(" BLAST:");
+  Serial.print(totalBlastTime);
+  Serial.print(" DEBOUNCE:");
+  Serial.print(debounce_timeout);
+  Serial.print(" PULSE:");
+  Serial.print(pulsePresetName(pulsePreset()));
+  Serial.print(" ABORT POLICY:");
+  Serial.println(activeAbortPolicy(), BIN);
+}
 
-  // update the nextion display machine status indicators for DOOR PRESENCE
-  if(current_door_sensor_value != prev_door_sensor_value) 
+// in AUTO mode the Delta may pick the recipe with every shaft it hands over.
+// not written to EEPROM, the Delta sets it again on the next handover.
+// the two recipe pins are not in the InputFilter (its sample byte has one bit left), so the
+// code is read twice and a mismatch keeps the current recipe
+void applyDeltaRecipeSelection()
+{
+  uint8_t code = DELTA_RECIPE_CODE;
+  delayMicroseconds(DELTA_RECIPE_RESAMPLE_US);
+  if(DELTA_RECIPE_CODE != code)
   {
-    if(!current_door_sensor_value) 
-    {
-      DELTA_MACHINE_IS_SAFE; // to delta
-      myNex.writeNum("p2.pic", NEX_CLOSED);   // DETECT DOOR OPEN->CLOSE TRANSITION
-      myNex.writeNum("p5.pic", NEX_SAFE);
-      if(enableSerialDebug) Serial.println("[INFO] DOOR CLOSE OPEN->CLOSE TRANSITION");
-    } 
-    else if (current_door_sensor_value) 
-    {
-      DELTA_MACHINE_NOT_SAFE; // to delta
-      myNex.writeNum("p2.pic", NEX_OPEN);     // DETECT DOOR CLOSE->OPEN TRANSITION
-      myNex.writeNum("p5.pic", NEX_NOT_SAFE);
-      if(enableSerialDebug) Serial.println("[INFO] DOOR CLOSE CLOSE->OPEN TRANSITION");
-    }
+    if(enableSerialDebug) Serial.println("[INFO] DELTA RECIPE CODE CHANGED WHILE READING, KEEPING THE CURRENT RECIPE");
+    return;
   }
+  if(code == 0) return; // Delta leaves it to the nextion
+  CLUB_TYPE type = (CLUB_TYPE)(code - 1);
+  if(type == activeClubType()) return;
+  selectRecipe(type);
+  printActiveRecipe();
+  updateNextionScreen();
+}
 
-  // ======= DELTA SPECIFIC NEXTION DISPLAY FUNCTIONS =======
-  
-
-  // update nextion display DELTA_CELL_ON information
-  if(current_delta_cell_on_value != prev_delta_cell_on_value) 
+void handleNextionButtons()
+{
+  if(nexbtn_sub_1_second) 
   {
-    if(current_delta_cell_on_value) 
-    {
-      myNex.writeNum("p9.pic", NEX_YES);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL ON NO->YES TRANSITION");
-    }
-    else if(!current_delta_cell_on_value) 
-    {
-      myNex.writeNum("p9.pic", NEX_NO);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL ON YES->NO TRANSITION");
-    }
+    if(totalBlastTime > totalBlastTime_min) totalBlastTime -= 1000;
+    if(totalBlastTime < totalBlastTime_min) totalBlastTime = totalBlastTime_min; // clamp to a min time
+    storeBlastTimeInRecipe();
+    printSavedParams();
   }
 
-  // update nextion display DELTA_CELL_FAULTED information
-  if(current_delta_cell_faulted_value != prev_delta_cell_faulted_value) 
+  if(nexbtn_add_1_second) 
   {
-    if(current_delta_cell_faulted_value) 
-    {
-      myNex.writeNum("p10.pic", NEX_YES);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL FAULTED NO->YES TRANSITION");
-    }
-    else if(!current_delta_cell_faulted_value) 
-    {
-      myNex.writeNum("p10.pic", NEX_NO);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL FAULTED YES->NO TRANSITION");
-    }
+    totalBlastTime += 1000;
+    if(totalBlastTime > totalBlastTime_max) totalBlastTime = totalBlastTime_max; // clamp to a max time
+    storeBlastTimeInRecipe();
+    printSavedParams();
   }
 
-  // update nextion display DELTA_CELL_IN_AUTO information
-  if(current_delta_cell_in_auto_value != prev_delta_cell_in_auto_value) 
+  if(nexbtn_switch_club_type)
   {
-    if(current_delta_cell_in_auto_value) 
-    {
-      myNex.writeNum("p11.pic", NEX_YES);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL IN AUTO NO->YES TRANSITION");
-    }
-    else if(!current_delta_cell_in_auto_value) 
-    {
-      myNex.writeNum("p11.pic", NEX_NO);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA CELL IN AUTO YES->NO TRANSITION");
-    }
+    chooseRecipe((CLUB_TYPE)((activeClubType() + 1) % CLUB_TYPE_COUNT));
+    printActiveRecipe();
+    printSavedParams();
   }
 
-  // update the nextion display machine status indicators for SHAFT PRESENCE
-  if(current_shaft_sensor_value != prev_shaft_sensor_value) 
+  if(nexbtn_reset_eeprom) 
   {
-    if(!current_shaft_sensor_value) 
-    {
-      DELTA_YES_SHAFT;
-      myNex.writeNum("p6.pic", NEX_YES);
-      myNex.writeNum("p3.pic", NEX_YES);      // DETECT SHAFT PRESENT
-    }
-    else if (current_shaft_sensor_value) 
-    {
-      DELTA_NO_SHAFT;
-      myNex.writeNum("p6.pic", NEX_NO_SHAFT);
-      myNex.writeNum("p3.pic", NEX_NO_SHAFT); // DETECT SHAFT ABSENT
-    }
+    clearEEPROMContents();
   }
 
-  handleMillisRolloverCondition(); // for both shaft timer and eeprom timer
-
-  // update nextion display shaft in place information
-  if(current_delta_sip_value != prev_sip_delta_value) 
+  nexbtn_sub_1_second = false;
+  nexbtn_add_1_second = false;
+  if(nexbtn_next_pulse_preset)
   {
-    if(current_delta_sip_value) 
-    {
-      myNex.writeNum("p8.pic", NEX_YES);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA SIP NO->YES TRANSITION");
+    // the blast that is running keeps its pattern, the preset applies from the next one
+    BlastRecipe recipe = activeRecipe();
+    recipe.pulse_preset = (pulsePreset() + 1) % PULSE_PRESET_COUNT;
+    updateActiveRecipe(recipe);
+    printActiveRecipe();
+    updateNextionScreen();
+  }
 
-      // for aligning the local "shaft in place" logic to the external Delta robot "shaft in place" logic. It will keep blasting over and over without this
-      currentShaftBlastHasBeenHandled_Delta = false; 
-    }
-    else if(!current_delta_sip_value) 
-    {
-      myNex.writeNum("p8.pic", NEX_NO_SHAFT);
-      if(enableSerialDebug) Serial.println("[INFO] DELTA SIP YES->NO TRANSITION");
+  nexbtn_reset_eeprom = false;
+  nexbtn_next_pulse_preset = false;
+  nexbtn_switch_club_type = false;
+}
 
-      //currentShaftBlastHasBeenHandled_Delta = true; // test 
-    }
-  }
+unsigned long diagnostics_last_update_time = 0;
+unsigned long diagnostics_update_period = 1000; // milliseconds
 
-  if(DELTA_MACHINE_AVAILABLE && !currentShaftBlastHasBeenHandled_Delta && !machineCurrentlyBlasting && (millis() - last_debounce_time > debounce_timeout)) 
+String sectionStatsText(const SectionStats& stats)
+{
+  if(stats.count == 0) return String("-");
+  return String(cyclesToMicros(stats.min_cycles)) + "/" + String(cyclesToMicros(stats.sum_cycles / stats.count)) + "/" + String(cyclesToMicros(stats.max_cycles)) + "us";
+}
+
+void printLoopProfile()
+{
+  Serial.println(" -- LOOP PROFILE (min/mean/max): -- ");
+  for(uint8_t i = 0; i < SECTION_COUNT; ++i)
   {
-    if(!current_door_sensor_value) 
-    {
-      // this dual check for a shaft may be redundant, probably just need current_shaft_sensor_value 
-      if(current_delta_sip_value && !current_shaft_sensor_value) 
-      {
-        Start_Blasting();
-        currentShaftBlastHasBeenHandled_Delta = true;
-        //currentShaftBlastHasBeenHandled_Ping = true;
-        previousBlastStartTime = millis();
-        last_debounce_time = previousBlastStartTime; 
-      }
-    }
+    Serial.print(loopSectionName((LOOP_SECTION)i));
+    Serial.print(":");
+    Serial.println(sectionStatsText(loopSectionStats((LOOP_SECTION)i)));
   }
+  Serial.print("FULL LOOP:");
+  Serial.println(sectionStatsText(loopIterationStats()));
+  Serial.print("WORST LOOP % OF WDT WINDOW:");
+  Serial.println(worstIterationPercentOfWDT());
+}
+
+const char* const stopReasonNames[] = { "COMPLETED", "DOOR OPEN", "DELTA SIP LOST", "DELTA UNAVAILABLE", "SHAFT REMOVED" };
+
+// the whole log takes ~20 s to go out at 9600 baud, so 'l' only opens a cursor
+// and serviceProductionDump() sends a line whenever the TX buffer has room for one
+#define PRODUCTION_LINE_MAX 60 // longest CSV line below, with CR LF
+
+ProductionLogCursor production_dump_cursor;
+bool production_dump_active = false;
+uint16_t production_dump_count = 0;
+
+void printProductionRecord(const ProductionRecord& record)
+{
+  Serial.print(record.start_delta_ms);
+  Serial.print(record.first_since_boot ? "*," : ",");
+  Serial.print(record.commanded_ms);
+  Serial.print(",");
+  Serial.print(record.actual_ms);
+  Serial.print(",");
+  Serial.print(stopReasonNames[record.reason]);
+  Serial.print(",");
+  Serial.print(record.mode == CYCLE_MODE_AUTO ? "AUTO" : "MANUAL");
+  Serial.print(",");
+  Serial.println(clubTypeName((CLUB_TYPE)record.club_type));
+}
+
+void endProductionDump(const char* note)
+{
+  Serial.print(" -- ");
+  Serial.print(production_dump_count);
+  Serial.print(" CYCLES");
+  Serial.print(note);
+  Serial.println(" -- ");
+  production_dump_active = false;
+}
 
-  if (machineCurrentlyBlasting) 
+// CSV, oldest cycle first. a * marks a start delta that is counted from a boot
+void dumpProductionLog()
+{
+  if(production_dump_active) return; // already going out
+  Serial.println(" -- PRODUCTION LOG: -- ");
+  Serial.println("start delta ms,commanded ms,actual ms,stop reason,mode,club type");
+  production_dump_count = 0;
+  production_dump_active = true;
+  if(!openProductionLog(production_dump_cursor)) endProductionDump("");
+}
+
+// at most one record per loop() iteration, and only if it goes out without blocking
+void serviceProductionDump()
+{
+  if(!production_dump_active) return;
+  if(Serial.availableForWrite() < PRODUCTION_LINE_MAX) return;
+
+  ProductionRecord record;
+  switch(nextProductionRecord(production_dump_cursor, record))
   {
-    if(current_door_sensor_value) 
-    {
-      // Something has opened the door during a blast cycle
-      if(enableSerialDebug) Serial.println("[INFO] STOPPED BLASTING. Reason: DOOR OPEN");
-      Stop_Blasting();
-    }
-    else if(!current_delta_sip_value) 
-    {
-      // Delta machine has removed the shaft from the sensor for some reason
-      // TODO: Maybe don't need this? Probably safe to leave it
-      if(enableSerialDebug) Serial.println("[INFO] STOPPED BLASTING. DELTA SHAFT NOT IN PLACE");
-      Stop_Blasting();
-    }
-    else if(!DELTA_MACHINE_AVAILABLE) 
-    {
-      // Delta machine has become unavailable for any reason
-      if(enableSerialDebug) Serial.println("[INFO] STOPPED BLASTING. DELTA MACHINE NOT AVAILABLE");
-      Stop_Blasting();
-    }
-    else if(millis() - previousBlastStartTime > totalBlastTime) 
-    { 
-      // shaft has been present for entire blast. turn off blasters
-      if(enableSerialDebug) Serial.println("[INFO] STOPPED BLASTING (success). BLAST TIME ACCOMPLISHED!");
-      Stop_Blasting();
-    }
-    else if (current_shaft_sensor_value) 
-    { 
-      // HIGH = NO SHAFT PRESENT
-      // Something or someone has moved the shaft away from the sensor
-      if(enableSerialDebug) Serial.println("[INFO] STOPPED BLASTING. PHYSICAL SHAFT REMOVED FROM SENSOR");
-      myNex.writeNum("p3.pic", NEX_NO_SHAFT); // "SHAFT SENSE = NO SHAFT"
-      Stop_Blasting();
-    }
+    case LOG_READ_RECORD:
+      printProductionRecord(record);
+      production_dump_count++;
+      break;
+    case LOG_READ_BUSY: break; // the EEPROM writer is busy, next iteration
+    case LOG_READ_END: endProductionDump(""); break;
+    case LOG_READ_OVERWRITTEN: endProductionDump(", THE REST WAS OVERWRITTEN WHILE DUMPING"); break;
   }
+}
 
-  myNex.NextionListen();
+String captureStatsText(const CaptureStats& stats)
+{
+  if(stats.count == 0) return String("-");
+  return String(stats.min_us) + "/" + String(captureMeanUs(stats)) + "/" + String(stats.max_us) + "us";
+}
 
-  if(nexbtn_sub_1_second) 
+void printShaftCapture()
+{
+  Serial.println(" -- SHAFT SENSOR INPUT CAPTURE (min/mean/max): -- ");
+  if(!SHAFT_CAPTURE_FITTED) Serial.println("not fitted (SHAFT_CAPTURE_FITTED, jumper 2->48)");
+  Serial.print("SHAFT SENSED:");
+  Serial.println(captureStatsText(shaftPresentWidth()));
+  Serial.print("GAP BETWEEN SHAFTS:");
+  Serial.println(captureStatsText(shaftGapWidth()));
+  Serial.print("SHAFT EDGE->RELAY ON:");
+  Serial.println(captureStatsText(shaftResponseTime()));
+}
+
+// only written while the hidden diagnostics page is showing
+void updateDiagnosticsPage()
+{
+  if(myNex.currentPageId != NEX_DIAGNOSTICS_PAGE) return;
+  if(millis() - diagnostics_last_update_time < diagnostics_update_period) return;
+  diagnostics_last_update_time = millis();
+
+  for(uint8_t i = 0; i < SECTION_COUNT; ++i)
   {
-    totalBlastTime -= 1000;
-    if(totalBlastTime <= 0) totalBlastTime = totalBlastTime_min; // clamp to a min time
-    updateEEPROMContents();
+    myNex.writeStr("pf" + String(i) + ".txt", sectionStatsText(loopSectionStats((LOOP_SECTION)i)));
   }
+  myNex.writeStr("pf6.txt", sectionStatsText(loopIterationStats()) + " " + String(worstIterationPercentOfWDT()) + "% WDT");
+  CrashRecord record;
+  myNex.writeStr("pf7.txt", crashRecord(0, record) ? crashRecordText(record) : String("no crash"));
+  myNex.writeStr("pf8.txt", "IN " + captureStatsText(shaftPresentWidth()) + " RESP " + captureStatsText(shaftResponseTime()));
+}
 
-  if(nexbtn_add_1_second) 
+// histogram as "bin start s:count", empty bins left out
+String blastHistogramText()
+{
+  String text;
+  for(uint8_t i = 0; i < BLAST_HISTOGRAM_BINS; ++i)
   {
-    totalBlastTime += 1000;
-    if(totalBlastTime > totalBlastTime_max) totalBlastTime = totalBlastTime_max; // clamp to a max time
-    updateEEPROMContents();
+    if(blastHistogramBin(i) == 0) continue;
+    text += String(i * BLAST_HISTOGRAM_BIN_MS / 1000) + "s:" + String(blastHistogramBin(i)) + " ";
   }
+  return text.length() ? text : String("-");
+}
 
-  if(nexbtn_reset_eeprom) 
+String stopCountsText()
+{
+  String text = "OK:" + String(stopReasonCount(STOP_COMPLETED));
+  text += " DOOR:" + String(stopReasonCount(STOP_DOOR_OPEN));
+  text += " SIP:" + String(stopReasonCount(STOP_DELTA_SIP_LOST));
+  text += " DELTA:" + String(stopReasonCount(STOP_DELTA_UNAVAILABLE));
+  text += " SHAFT:" + String(stopReasonCount(STOP_SHAFT_REMOVED));
+  return text;
+}
+
+String latencyText()
+{
+  const LatencyStats& latency = sipToBlastLatency();
+  if(latency.count == 0) return String("-");
+  return String(latency.mean_ms, 0) + " +/- " + String(latencyStdDevMs(latency), 0) + "ms max " + String(latency.max_ms) + "ms n=" + String(latency.count);
+}
+
+// min/mean/max in ms, the phases run from well under a ms to the blast time
+String handshakePhaseText(HANDSHAKE_PHASE phase)
+{
+  const PhaseStats& stats = handshakePhaseStats(phase);
+  if(stats.count == 0) return String("-");
+  return String(stats.min_us / 1000) + "/" + String(handshakePhaseMeanUs(phase) / 1000) + "/" + String(stats.max_us / 1000) + "ms";
+}
+
+void printHandshakeTiming()
+{
+  Serial.println(" -- DELTA HANDSHAKE PHASES (min/mean/max): -- ");
+  for(uint8_t i = 0; i < HANDSHAKE_PHASE_COUNT; ++i)
   {
-    clearEEPROMContents();
+    Serial.print(handshakePhaseName((HANDSHAKE_PHASE)i));
+    Serial.print(":");
+    Serial.println(handshakePhaseText((HANDSHAKE_PHASE)i));
   }
+  Serial.print("SHAFT BEFORE SIP:");
+  Serial.println(handshakesShaftFirst());
+  Serial.print("INCOMPLETE:");
+  Serial.println(handshakesIncomplete());
+  Serial.print("DEBOUNCE TIMEOUT (ms):");
+  Serial.println(debounce_timeout);
+}
 
-  // update EEPROM every EEPROM_save_period milliseconds
-  if((unsigned long)millis() - EEPROM_last_save_time >= EEPROM_save_period) 
+void printAdaptiveDebounce()
+{
+  Serial.print(" -- ADAPTIVE DEBOUNCE ");
+  Serial.print(adaptiveDebounceEnabled() ? "ON" : "OFF");
+  Serial.println(adaptiveDebounceCalibrated() ? " (calibrated) -- " : " (collecting) -- ");
+  const INPUT_INDEX inputs[] = { INPUT_SHAFT_PRESENT, INPUT_DELTA_SIP };
+  for(uint8_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
   {
-    updateEEPROMContents();
-    EEPROM_last_save_time = millis();
+    Serial.print(inputNames[inputs[i]]);
+    Serial.print(" SETTLE:");
+    Serial.print(inputSettleTime(inputs[i]));
+    Serial.print("ms WORST GAP:");
+    Serial.print(worstChatterGapUs(inputs[i]));
+    Serial.print("us WORST BURST:");
+    Serial.print(worstChatterBurstMs(inputs[i]));
+    Serial.println("ms");
   }
+  Serial.print("BLAST GAP (ms):");
+  Serial.print(adaptiveBlastGap(debounce_timeout));
+  Serial.print(" of ");
+  Serial.println(debounce_timeout);
+}
 
-  nexbtn_sub_1_second = false;
-  nexbtn_add_1_second = false;
-  nexbtn_reset_eeprom = false;
-  
-  // local machine tracking:
-  prev_shaft_sensor_value = current_shaft_sensor_value;
-  prev_door_sensor_value  = current_door_sensor_value;
-  // external delta machine tracking:
-  prev_sip_delta_value = current_delta_sip_value;
-  prev_delta_cell_on_value = current_delta_cell_on_value;
-  prev_delta_cell_faulted_value = current_delta_cell_faulted_value;
-  prev_delta_cell_in_auto_value = current_delta_cell_in_auto_value;
-
-  //outputHeartbeatSignal();  // HB
+void printBlastStats()
+{
+  Serial.println(" -- BLAST STATS SINCE BOOT: -- ");
+  Serial.print("DURATION HISTOGRAM:");
+  Serial.println(blastHistogramText());
+  Serial.print("STOPS:");
+  Serial.println(stopCountsText());
+  Serial.print("RELAY ON (s):");
+  Serial.println(relayOnSeconds());
+  Serial.print("SIP->BLAST LATENCY:");
+  Serial.println(latencyText());
 }
 
-void manualModeLoop()
+void printThroughput()
 {
-  bool current_shaft_sensor_value  = SHAFT_SENSOR;    // LOW = SHAFT PRESENT // HIGH = NO SHAFT PRESENT
-  bool current_door_sensor_value   = DOOR_SENSOR;     // LOW = DOOR CLOSED // HIGH = DOOR OPEN
+  Serial.print("SHAFTS/HOUR (last ");
+  Serial.print(THROUGHPUT_WINDOW_MINUTES);
+  Serial.print(" min):");
+  Serial.println(shaftsPerHour());
+  Serial.print("HOURLY (this hour, then newest first):");
+  Serial.println(hourlyCountsText());
+}
 
-  // update the nextion display machine status indicators for DOOR PRESENCE
-  if(current_door_sensor_value != prev_door_sensor_value) {
-    if(!current_door_sensor_value) {
-      myNex.writeNum("p2.pic", NEX_CLOSED);   // DETECT DOOR OPEN->CLOSE TRANSITION
-    } 
-    else if (current_door_sensor_value) {
-      myNex.writeNum("p2.pic", NEX_OPEN);     // DETECT DOOR CLOSE->OPEN TRANSITION
-    }
-  }
+unsigned long stats_last_update_time = 0;
 
-  // update the nextion display machine status indicators for SHAFT PRESENCE
-  if(current_shaft_sensor_value != prev_shaft_sensor_value) {
-    if(!current_shaft_sensor_value) {
-      myNex.writeNum("p3.pic", NEX_YES);      // DETECT SHAFT PRESENT
-    }
-    else if (current_shaft_sensor_value) {
-      myNex.writeNum("p3.pic", NEX_NO_SHAFT); // DETECT SHAFT ABSENT
-    }
+// only written while the stats page is showing
+void updateStatsPage()
+{
+  if(myNex.currentPageId != NEX_STATS_PAGE) return;
+  if(millis() - stats_last_update_time < diagnostics_update_period) return;
+  stats_last_update_time = millis();
+
+  myNex.writeStr("st0.txt", blastHistogramText());
+  myNex.writeStr("st1.txt", stopCountsText());
+  myNex.writeStr("st2.txt", String(relayOnSeconds()) + "s");
+  myNex.writeStr("st3.txt", latencyText());
+  for(uint8_t i = 0; i < HANDSHAKE_PHASE_COUNT; ++i)
+  {
+    myNex.writeStr("hs" + String(i) + ".txt", handshakePhaseText((HANDSHAKE_PHASE)i));
   }
+}
 
-  handleMillisRolloverCondition(); // for both shaft timer and eeprom timer
+// single character commands on the debug serial port
+void handleSerialCommands()
+{
+  if(!enableSerialDebug) return;
 
-  if(!machineCurrentlyBlasting && (millis() - last_debounce_time > debounce_timeout)) {
-    if(!current_door_sensor_value) {
-      if (prev_shaft_sensor_value == true && current_shaft_sensor_value == false) { // check if this is a HIGH->LOW transition
-        myNex.writeNum("p3.pic", NEX_YES); // "SHAFT SENSE = YES"
-        Start_Blasting();
-        previousBlastStartTime = millis();
-        last_debounce_time = previousBlastStartTime; 
-      }
+  while(Serial.available() > 0)
+  {
+    switch(Serial.read())
+    {
+      case 'p': printLoopProfile(); break;
+      case 'P': resetLoopProfile(); break;
+      case 'b': nexbtn_next_pulse_preset = true; break; // handled with the nextion buttons
+      case 'c': nexbtn_switch_club_type = true; break;
+      case 'r': printActiveRecipe(); break;
+      case 'j': printCrashJournal(); break;
+      case 'l': dumpProductionLog(); break;
+      case 's': printBlastStats(); break;
+      case 'h': printThroughput(); break;
+      case 'd': printHandshakeTiming(); break;
+      case 'D': resetHandshakeTiming(); break;
+      case 'a': printAdaptiveDebounce(); break;
+      case 'A': setAdaptiveDebounce(!adaptiveDebounceEnabled()); printAdaptiveDebounce(); break;
+      case 'i': printShaftCapture(); break;
+      case 'I': resetShaftCapture(); break;
+      case 'S': resetBlastStats(); break;
+      default: break;
     }
   }
+}
 
-  if (machineCurrentlyBlasting) {
-    if(current_door_sensor_value) {
-      Stop_Blasting();
-    }
-    else if(millis() - previousBlastStartTime > totalBlastTime) { // shaft has been present for entire blast. turn off blasters
-      Stop_Blasting();
-    }
-    else if (current_shaft_sensor_value) { // HIGH = NO SHAFT PRESENT
-      myNex.writeNum("p3.pic", NEX_NO_SHAFT); // "SHAFT SENSE = NO SHAFT"
-      Stop_Blasting();
-    }
-  }
+void loop() 
+{
+  if(!wdt_fired) wdt_reset(); // if we don't reset the WDT within 2 seconds the arduino will restart
+                              // NOTE: If we DO restart due to WDT, the EEPROM settings will be updated before the restart.
+                              // once ISR(WDT_vect) has run, loop() must not push the reset out any more
+  loopProfileBegin();
 
-  myNex.NextionListen();
+  loopProfileSection(SECTION_INPUT_READ);
+  processEdgeEvents();
+  serviceAdaptiveDebounce(edgeEventsDropped());
 
-  if(nexbtn_sub_1_second) {
-    totalBlastTime -= 1000;
-    if(totalBlastTime <= 0) totalBlastTime = totalBlastTime_min; // clamp to a min time
-    updateEEPROMContents();
-  }
+  uint8_t current_inputs = readFilteredInputs();
+  uint8_t changed_inputs = current_inputs ^ prev_inputs;
 
-  if(nexbtn_add_1_second) {
-    totalBlastTime += 1000;
-    if(totalBlastTime > totalBlastTime_max) totalBlastTime = totalBlastTime_max; // clamp to a max time
-    updateEEPROMContents();
+  loopProfileSection(SECTION_DISPLAY);
+  if(changed_inputs & IN_MODE_MANUAL)
+  {
+    resetBeforeEnteringMode(current_inputs);
   }
-
-  if(nexbtn_reset_eeprom) {
-    clearEEPROMContents();
+  else
+  {
+    updateStatusIndicators(current_inputs, changed_inputs);
   }
-
-  // update EEPROM every EEPROM_save_period milliseconds
-  if((unsigned long)millis() - EEPROM_last_save_time >= EEPROM_save_period) {
-    updateEEPROMContents();
-    EEPROM_last_save_time = millis();
+  updateDiagnosticsPage();
+  updateStatsPage();
+  if(serviceThroughputMeter())
+  {
+    updateThroughputText();
+    updateHourlyCountsText();
   }
 
-  nexbtn_sub_1_second = false;
-  nexbtn_add_1_second = false;
-  nexbtn_reset_eeprom = false;
-  //nexbtn_switch_club_type = false;
-  
-  prev_shaft_sensor_value = current_shaft_sensor_value;
-  prev_door_sensor_value  = current_door_sensor_value;
-}
-
+  loopProfileSection(SECTION_BLAST_CONTROL);
+  handleMillisRolloverCondition(); // for both shaft timer and eeprom timer
 
+  // the Delta sets its recipe lines before it raises SIP, so the recipe is resolved with the handover
+  if((changed_inputs & current_inputs & IN_DELTA_SIP) && currentCycleMode() == CYCLE_MODE_AUTO && !machineCurrentlyBlasting)
+  {
+    applyDeltaRecipeSelection();
+  }
 
-void loop() 
-{
-  wdt_reset(); // if we don't reset the WDT within 2 seconds the arduino will restart
-               // NOTE: If we DO restart due to WDT, the EEPROM settings will be updated before the restart
-  
-  bool mode_switch_current_value = MODE_CHOICE;
+  CycleInputs cycle_inputs;
+  cycle_inputs.door_open          = current_inputs & IN_DOOR_OPEN;
+  cycle_inputs.shaft_present      = current_inputs & IN_SHAFT_PRESENT;
+  cycle_inputs.shaft_arrived      = (changed_inputs & IN_SHAFT_PRESENT) && cycle_inputs.shaft_present;
+  cycle_inputs.delta_sip          = current_inputs & IN_DELTA_SIP;
+  cycle_inputs.delta_sip_arrived  = (changed_inputs & IN_DELTA_SIP) && cycle_inputs.delta_sip;
+  cycle_inputs.delta_available    = deltaMachineAvailable(current_inputs);
+  cycle_inputs.debounce_elapsed   = millis() - last_debounce_time > adaptiveBlastGap(debounce_timeout);
+  cycle_inputs.blast_time_elapsed = machineCurrentlyBlasting && (millis() - previousBlastStartTime > totalBlastTime);
+  cycle_inputs.abort_policy       = activeAbortPolicy();
+  runBlastCycle(cycle_inputs);
+
+  loopProfileSection(SECTION_NEXTION_LISTEN);
+  myNex.NextionListen();
 
-  if(mode_switch_current_value != mode_switch_previous_value)
-  {
-    ModeStatus_ManualIfTrueAutoIfFalse = mode_switch_current_value;
+  loopProfileSection(SECTION_BUTTONS);
+  handleNextionButtons();
+  handleSerialCommands();
+  serviceProductionDump();
 
-    if(!ModeStatus_ManualIfTrueAutoIfFalse) // False = Auto
-    {
-      resetBeforeEnteringAutoMode();
-    }
-    else if(ModeStatus_ManualIfTrueAutoIfFalse) // True = Manual Mode
-    {
-      resetBeforeEnteringManualMode();
-    }
-  }
-  
-  if(ModeStatus_ManualIfTrueAutoIfFalse)
-  {
-    manualModeLoop();
-  }
-  else if(!ModeStatus_ManualIfTrueAutoIfFalse)
+  loopProfileSection(SECTION_EEPROM);
+  // report the saved params every params_dump_period milliseconds
+  if((unsigned long)millis() - params_last_dump_time >= params_dump_period) 
   {
-    automationModeLoop();
+    printSavedParams();
+    params_last_dump_time = millis();
   }
 
-  mode_switch_previous_value = mode_switch_current_value; 
-}
\ No newline at end of file
+  prev_inputs = current_inputs;
+
+  //outputHeartbeatSignal();  // HB
+  loopProfileEnd();
+}